@@ -0,0 +1,752 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <malloc.h>
+
+#include "rectangle.hpp"
+#include "intersection.hpp"
+#include "intersection_stream.hpp"
+#include "duplicate_classes.hpp"
+#include "intersection_tree.hpp"
+#include "input.hpp"
+#include "output.hpp"
+#include "coverage.hpp"
+#include "rtree.hpp"
+#include "intersection_index.hpp"
+
+using std::vector, std::string;
+
+// Times a single call of f, in milliseconds
+double time_ms(const std::function<void()> &f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Every rectangle overlaps every other one, so every subset of ids is an intersection.
+// This is the worst case for id set deduplication
+vector<Rectangle> all_overlapping(size_t count, uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<uint32_t> jitter(0, 20);
+    vector<Rectangle> rects;
+    for (size_t i = 0; i < count; i += 1)
+    {
+        rects.push_back(Rectangle({.x = 100 + jitter(gen), .y = 100 + jitter(gen), .w = 200, .h = 200}));
+    }
+    return rects;
+}
+
+void bench_enumeration()
+{
+    std::cout << "--> Enumeration of id sets, heavily overlapping inputs\n";
+    std::cout << std::setw(8) << "rects" << std::setw(16) << "intersections" << std::setw(16) << "linear (ms)" << std::setw(16) << "hashed (ms)" << std::setw(16) << "canonical (ms)" << "\n";
+    for (size_t count = 6; count <= 13; count += 1)
+    {
+        auto rects = all_overlapping(count, count);
+        size_t found = 0;
+        double linear = time_ms([&]()
+                                { found = Intersection::get_intersections(rects, {.enumeration = Enumeration::Exhaustive, .dedup = Dedup::LinearScan}).size(); });
+        double hashed = time_ms([&]()
+                                { Intersection::get_intersections(rects, {.enumeration = Enumeration::Exhaustive, .dedup = Dedup::Hashed}); });
+        double canonical = time_ms([&]()
+                                   { Intersection::get_intersections(rects, {.enumeration = Enumeration::Canonical}); });
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(8) << count << std::setw(16) << found << std::setw(16) << linear << std::setw(16) << hashed << std::setw(16) << canonical << "\n";
+    }
+}
+
+// Random boxes spread so that roughly half of them hit the probe
+vector<Rectangle> random_boxes(size_t count, uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<uint32_t> pos(0, 1000);
+    std::uniform_int_distribution<uint32_t> size(1, 500);
+    vector<Rectangle> rects;
+    for (size_t i = 0; i < count; i += 1)
+    {
+        rects.push_back(Rectangle({.x = pos(gen), .y = pos(gen), .w = size(gen), .h = size(gen)}));
+    }
+    return rects;
+}
+
+// intersect_batch on every instruction set, with the boxes converted to T coordinates
+template <typename T>
+void bench_batch(const vector<Rectangle> &boxes, const Rectangle &probe, int rounds, const string &label)
+{
+    BasicRectangleSoA<T> soa(convert_rectangles<T>(boxes));
+    BasicRectangle<T> shape = convert_rectangles<T>(vector<Rectangle>{probe}).front();
+    BasicRectangleSoA<T> clipped;
+    std::vector<uint64_t> hits;
+    for (Isa isa : {Isa::Scalar, Isa::Sse42, Isa::Avx2})
+    {
+        if (!isa_supported(isa))
+        {
+            std::cout << std::setw(24) << label + isa_name(isa) << "  not supported by this CPU\n";
+            continue;
+        }
+        size_t batch_hits = 0;
+        double batch = time_ms([&]()
+                               {
+            for (int r = 0; r < rounds; r += 1) {
+                batch_hits += intersect_batch(shape, soa, 0, soa.size(), clipped, hits, isa);
+            } });
+        std::cout << std::setw(24) << label + isa_name(isa) << std::setw(12) << batch << " ms" << std::setw(12) << batch_hits / rounds << " hits\n";
+    }
+}
+
+void bench_intersect_kernel()
+{
+    const size_t count = 1 << 16;
+    const int rounds = 200;
+    auto boxes = random_boxes(count, 1);
+    Rectangle probe({.x = 250, .y = 250, .w = 500, .h = 500});
+
+    std::cout << "--> Intersect " << count << " boxes against one shape, " << rounds << " rounds\n";
+    size_t scalar_hits = 0;
+    double scalar = time_ms([&]()
+                            {
+        for (int r = 0; r < rounds; r += 1) {
+            for (auto const &box : boxes) {
+                scalar_hits += probe.intersect(box).has_value();
+            }
+        } });
+    std::cout << std::fixed << std::setprecision(2) << std::setw(24) << "Rectangle::intersect" << std::setw(12) << scalar << " ms" << std::setw(12) << scalar_hits / rounds << " hits\n";
+
+    bench_batch<uint32_t>(boxes, probe, rounds, "intersect_batch ");
+    // the same boxes as uint16_t coordinates: twice as many per register
+    bench_batch<uint16_t>(boxes, probe, rounds, "u16 batch ");
+}
+
+// Vertical bars, horizontal bars, then vertical bars again, disjoint from the first ones.
+// Extending a (vertical, horizontal) pair clips it against every bar of the last family, and they all miss
+vector<Rectangle> crossing_bars(uint32_t count)
+{
+    vector<Rectangle> rects;
+    for (uint32_t i = 0; i < count; i += 1)
+    {
+        rects.push_back(Rectangle({.x = i * 10, .y = 0, .w = 2, .h = count * 10}));
+    }
+    for (uint32_t i = 0; i < count; i += 1)
+    {
+        rects.push_back(Rectangle({.x = 0, .y = i * 10, .w = count * 10, .h = 2}));
+    }
+    for (uint32_t i = 0; i < count; i += 1)
+    {
+        rects.push_back(Rectangle({.x = i * 10 + 5, .y = 0, .w = 2, .h = count * 10}));
+    }
+    return rects;
+}
+
+void bench_engine_kernel()
+{
+    const uint32_t count = 300;
+    auto rects = crossing_bars(count);
+    std::cout << "--> Canonical enumeration of " << rects.size() << " crossing bars\n";
+    for (Isa isa : {Isa::Scalar, Isa::Sse42, Isa::Avx2})
+    {
+        if (!isa_supported(isa))
+        {
+            continue;
+        }
+        size_t found = 0;
+        double ms = time_ms([&]()
+                            { found = Intersection::get_intersections(rects, {.isa = isa}).size(); });
+        std::cout << std::setw(24) << isa_name(isa) << std::setw(12) << ms << " ms" << std::setw(12) << found << " intersections\n";
+    }
+}
+
+// Speedup of the work-stealing engine over the serial one
+void bench_threads()
+{
+    auto rects = all_overlapping(16, 16);
+    std::cout << "--> Canonical enumeration of " << rects.size() << " overlapping rectangles by thread count ("
+              << std::thread::hardware_concurrency() << " hardware threads)\n";
+    double serial_ms = 0;
+    for (unsigned threads : {1u, 2u, 4u, 8u, 16u})
+    {
+        size_t found = 0;
+        double ms = time_ms([&]()
+                            { found = Intersection::get_intersections(rects, {.threads = threads}).size(); });
+        if (threads == 1)
+        {
+            serial_ms = ms;
+        }
+        std::cout << std::setw(24) << threads << std::setw(12) << ms << " ms" << std::setw(12) << serial_ms / ms << "x"
+                  << std::setw(12) << found << " intersections\n";
+    }
+}
+
+// Dense scenes: every subset is an intersection, but there is a single maximal one
+void bench_maximal()
+{
+    std::cout << "--> All vs maximal intersections of overlapping rectangles\n";
+    std::cout << std::setw(8) << "rects" << std::setw(16) << "all" << std::setw(16) << "maximal" << "\n";
+    for (size_t count : {12, 16, 18, 1000})
+    {
+        auto rects = all_overlapping(count, count);
+        std::cout << std::setw(8) << count;
+        if (count <= 18)
+        {
+            std::cout << std::setw(13) << time_ms([&]()
+                                                  { Intersection::get_intersections(rects); })
+                      << " ms";
+        }
+        else
+        {
+            std::cout << std::setw(16) << "-";
+        }
+        std::cout << std::setw(13) << time_ms([&]()
+                                              { Intersection::get_maximal_intersections(rects); })
+                  << " ms\n";
+    }
+}
+
+// Bounds pushed into the search against the whole enumeration
+void bench_queries()
+{
+    auto rects = all_overlapping(18, 18);
+    std::cout << "--> Queries on " << rects.size() << " overlapping rectangles\n";
+    auto row = [](const string &name, const std::function<size_t()> &query)
+    {
+        size_t found = 0;
+        double ms = time_ms([&]()
+                            { found = query(); });
+        std::cout << std::setw(24) << name << std::setw(12) << ms << " ms" << std::setw(12) << found << " intersections\n";
+    };
+    row("max degree 3", [&]()
+        { return Intersection::get_intersections(rects, {.max_degree = 3}).size(); });
+    row("top 10 by area", [&]()
+        { return Intersection::get_largest_intersections(rects, 10).size(); });
+    row("all", [&]()
+        { return Intersection::get_intersections(rects).size(); });
+}
+
+// Aggregates straight from the rectangles, on inputs far too deep to enumerate
+void bench_coverage()
+{
+    auto rects = random_boxes(10000, 2);
+    std::cout << "--> Coverage of " << rects.size() << " random boxes by tracked depth levels\n";
+    for (size_t levels : {1, 8, 64, 256})
+    {
+        CoverageStats stats;
+        double ms = time_ms([&]()
+                            { stats = coverage_stats(rects, levels); });
+        std::cout << std::setw(24) << levels << std::setw(12) << ms << " ms" << std::setw(12) << stats.max_depth << " max depth\n";
+    }
+}
+
+// Point queries through the R-tree against a scan of every rectangle
+void bench_rtree()
+{
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<uint32_t> pos(0, 1000000);
+    std::uniform_int_distribution<uint32_t> size(1, 2000);
+    vector<Rectangle> rects;
+    for (size_t i = 0; i < 100000; i += 1)
+    {
+        rects.push_back(Rectangle({.x = pos(gen), .y = pos(gen), .w = size(gen), .h = size(gen)}));
+    }
+    vector<Point> points;
+    for (size_t i = 0; i < 100000; i += 1)
+    {
+        points.push_back(Point{.x = pos(gen), .y = pos(gen)});
+    }
+    std::cout << "--> " << points.size() << " point queries on " << rects.size() << " rectangles\n";
+    RTree tree;
+    double build_ms = time_ms([&]()
+                              { tree = RTree(rects); });
+    size_t found = 0;
+    double tree_ms = time_ms([&]()
+                             {
+                                 for (Point point : points)
+                                 {
+                                     found += tree.containing(point).size();
+                                 } });
+    // the scan is only timed on 1% of the queries
+    size_t scanned = 0;
+    double scan_ms = time_ms([&]()
+                             {
+                                 for (size_t q = 0; q < points.size() / 100; q += 1)
+                                 {
+                                     for (const Rectangle &rect : rects)
+                                     {
+                                         scanned += rect.m_x <= points[q].x && points[q].x < rect.m_x + rect.m_w && rect.m_y <= points[q].y && points[q].y < rect.m_y + rect.m_h;
+                                     }
+                                 } }) * 100;
+    std::cout << std::setw(24) << "STR bulk load" << std::setw(12) << build_ms << " ms\n";
+    std::cout << std::setw(24) << "r-tree" << std::setw(12) << tree_ms << " ms" << std::setw(12) << found << " hits\n";
+    std::cout << std::setw(24) << "linear scan (estimated)" << std::setw(12) << scan_ms << " ms\n";
+}
+
+// One change at a time against recomputing everything after each change
+void bench_incremental()
+{
+    std::mt19937 gen(4);
+    std::uniform_int_distribution<uint32_t> pos(0, 100000);
+    std::uniform_int_distribution<uint32_t> size(1, 1000);
+    auto random_rect = [&]()
+    { return Rectangle({.x = pos(gen), .y = pos(gen), .w = size(gen), .h = size(gen)}); };
+    vector<Rectangle> rects;
+    for (size_t i = 0; i < 20000; i += 1)
+    {
+        rects.push_back(random_rect());
+    }
+    const size_t changes = 1000;
+    std::cout << "--> " << changes << " adds and removes on " << rects.size() << " rectangles\n";
+    IntersectionIndex index(rects);
+    double index_ms = time_ms([&]()
+                              {
+                                  for (size_t i = 0; i < changes; i += 1)
+                                  {
+                                      index.remove(index.add(random_rect()) - 1);
+                                  } });
+    double rerun_ms = time_ms([&]()
+                              { Intersection::get_intersections(rects); });
+    std::cout << std::setw(24) << "IntersectionIndex" << std::setw(12) << index_ms << " ms\n";
+    std::cout << std::setw(24) << "get_intersections, once" << std::setw(12) << rerun_ms << " ms\n";
+}
+
+// Bytes of heap in use, as malloc sees it
+size_t heap_in_use()
+{
+    return mallinfo2().uordblks;
+}
+
+// Heap held by the whole output as a std::set against the prefix tree
+void bench_tree()
+{
+    std::cout << "--> Heap held by the intersections of overlapping rectangles\n";
+    std::cout << std::setw(24) << "scene" << std::setw(16) << "intersections" << std::setw(16) << "set (MiB)" << std::setw(16) << "tree (MiB)"
+              << std::setw(16) << "set (ms)" << std::setw(16) << "tree (ms)" << "\n";
+    auto row = [](const string &name, const vector<Rectangle> &rects)
+    {
+        size_t before = heap_in_use();
+        std::set<Intersection> set;
+        double set_ms = time_ms([&]()
+                                { set = Intersection::get_intersections(rects); });
+        size_t set_bytes = heap_in_use() - before;
+        size_t found = set.size();
+        set.clear();
+        before = heap_in_use();
+        std::optional<IntersectionTree> tree;
+        // built and read back in full, which is what printing it costs
+        double tree_ms = time_ms([&]()
+                                 {
+                                     tree.emplace(rects);
+                                     for (auto it = tree->begin(); it != tree->end(); ++it)
+                                     {
+                                     } });
+        size_t tree_bytes = heap_in_use() - before;
+        std::cout << std::setw(24) << name << std::setw(16) << found << std::setw(16) << set_bytes / 1048576.0
+                  << std::setw(16) << tree_bytes / 1048576.0 << std::setw(16) << set_ms << std::setw(16) << tree_ms << "\n";
+    };
+    row("18 overlapping", all_overlapping(18, 18));
+    // the overlapping ones get ids past 64, which IdSet stores out of line
+    auto spilled = all_overlapping(18, 18);
+    for (uint32_t i = 0; i < 64; i += 1)
+    {
+        spilled.insert(spilled.begin(), Rectangle({.x = 1000 + i * 10, .y = 0, .w = 5, .h = 5}));
+    }
+    row("64 apart, 18 overlapping", spilled);
+}
+
+// Scene generators of the end to end suite. Each one is deterministic for a given count and seed
+
+// Boxes spread over a square that grows with the count, so each one overlaps about 4 others at any size.
+// Smaller max_size make it sparser
+vector<Rectangle> uniform_scene(size_t count, uint32_t seed, uint32_t max_size = 2000)
+{
+    std::mt19937 gen(seed);
+    uint32_t side = static_cast<uint32_t>(1000 * std::sqrt(static_cast<double>(count)));
+    std::uniform_int_distribution<uint32_t> pos(0, side);
+    std::uniform_int_distribution<uint32_t> size(1, max_size);
+    vector<Rectangle> rects;
+    for (size_t i = 0; i < count; i += 1)
+    {
+        rects.push_back(Rectangle({.x = pos(gen), .y = pos(gen), .w = size(gen), .h = size(gen)}));
+    }
+    return rects;
+}
+
+// Groups of 100 boxes normally distributed around random centres
+vector<Rectangle> clustered_scene(size_t count, uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    size_t clusters = std::max<size_t>(1, count / 100);
+    uint32_t side = static_cast<uint32_t>(20000 * std::sqrt(static_cast<double>(clusters)));
+    std::uniform_int_distribution<uint32_t> centre(10000, side + 10000);
+    std::normal_distribution<double> offset(0, 2000);
+    std::uniform_int_distribution<uint32_t> size(1, 1000);
+    vector<std::pair<double, double>> centres;
+    for (size_t c = 0; c < clusters; c += 1)
+    {
+        centres.emplace_back(centre(gen), centre(gen));
+    }
+    vector<Rectangle> rects;
+    for (size_t i = 0; i < count; i += 1)
+    {
+        auto [cx, cy] = centres[i % clusters];
+        // the margin around the centres keeps the coordinates positive
+        rects.push_back(Rectangle({.x = static_cast<uint32_t>(std::max(0.0, cx + offset(gen))),
+                                   .y = static_cast<uint32_t>(std::max(0.0, cy + offset(gen))),
+                                   .w = size(gen),
+                                   .h = size(gen)}));
+    }
+    return rects;
+}
+
+// Stacks of 5 boxes, each strictly inside the previous one, laid out on a grid without touching each other.
+// Every subset of a stack is an intersection
+vector<Rectangle> nested_stack_scene(size_t count, uint32_t seed)
+{
+    const uint32_t depth = 5;
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<uint32_t> inset(1, 10);
+    uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count) / depth)));
+    vector<Rectangle> rects;
+    for (uint32_t stack = 0; rects.size() < count; stack += 1)
+    {
+        uint32_t x = stack % columns * 200, y = stack / columns * 200, w = 150, h = 150;
+        for (uint32_t level = 0; level < depth && rects.size() < count; level += 1)
+        {
+            rects.push_back(Rectangle({.x = x, .y = y, .w = w, .h = h}));
+            uint32_t d = inset(gen);
+            x += d;
+            y += d;
+            w -= 2 * d;
+            h -= 2 * d;
+        }
+    }
+    return rects;
+}
+
+// A sparse uniform scene with every box repeated 3 times
+vector<Rectangle> duplicate_scene(size_t count, uint32_t seed)
+{
+    auto distinct = uniform_scene((count + 2) / 3, seed, 600);
+    vector<Rectangle> rects;
+    for (size_t i = 0; i < count; i += 1)
+    {
+        rects.push_back(distinct[i / 3]);
+    }
+    return rects;
+}
+
+// A grid of boxes sharing their edges. Edges are half open, so nothing overlaps
+vector<Rectangle> grid_adjacent_scene(size_t count, uint32_t)
+{
+    uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    vector<Rectangle> rects;
+    for (uint32_t i = 0; i < count; i += 1)
+    {
+        rects.push_back(Rectangle({.x = i % columns * 10, .y = i / columns * 10, .w = 10, .h = 10}));
+    }
+    return rects;
+}
+
+// The input document of rects, as main reads it
+string to_json(const vector<Rectangle> &rects)
+{
+    string json = "{\"rects\":[";
+    for (size_t i = 0; i < rects.size(); i += 1)
+    {
+        json += (i == 0 ? "{\"x\":" : ",{\"x\":") + std::to_string(rects[i].m_x) + ",\"y\":" + std::to_string(rects[i].m_y) +
+                ",\"w\":" + std::to_string(rects[i].m_w) + ",\"h\":" + std::to_string(rects[i].m_h) + "}";
+    }
+    return json + "]}";
+}
+
+// Takes whatever is written to it and drops it, so the output phase times the formatting and not a device
+class NullBuffer : public std::streambuf
+{
+protected:
+    std::streamsize xsputn(const char *, std::streamsize count) override { return count; }
+    int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+};
+
+// Fastest of repeated calls of f, repeating until at least min_total_ms have passed or 20 calls were made
+double best_time_ms(const std::function<void()> &f, double min_total_ms = 100)
+{
+    double best = time_ms(f), total = best;
+    for (int calls = 1; calls < 20 && total < min_total_ms; calls += 1)
+    {
+        double ms = time_ms(f);
+        best = std::min(best, ms);
+        total += ms;
+    }
+    return best;
+}
+
+// The stream of main on inputs of at most 64 rectangles, walked by a SmallSearch and by the generic CanonicalSearch
+void bench_small_search()
+{
+    std::cout << "--> Streamed canonical enumeration of small inputs\n";
+    std::cout << std::setw(24) << "scene" << std::setw(16) << "intersections" << std::setw(16) << "generic (ms)" << std::setw(16) << "small (ms)" << std::setw(12) << "speedup" << "\n";
+    auto row = [](const string &name, const vector<Rectangle> &rects)
+    {
+        size_t found = 0;
+        auto walk = [&](bool small_search)
+        {
+            found = 0;
+            for (IntersectionStream stream(rects, {.small_search = small_search}); stream.next().has_value();)
+            {
+                found += 1;
+            }
+        };
+        double generic = best_time_ms([&]()
+                                      { walk(false); });
+        double small = best_time_ms([&]()
+                                    { walk(true); });
+        std::cout << std::fixed << std::setprecision(3) << std::setw(24) << name << std::setw(16) << found << std::setw(16) << generic
+                  << std::setw(16) << small << std::setw(11) << generic / small << "x\n";
+    };
+    row("10 overlapping", all_overlapping(10, 10));
+    row("16 overlapping", all_overlapping(16, 16));
+    row("uniform 64", uniform_scene(64, 64));
+    row("clustered 64", clustered_scene(64, 64));
+}
+
+// Loading large scenes: the streaming JSON parser against the binary reader, both from memory
+void bench_binary_input()
+{
+    std::cout << "--> Loading JSON and binary input documents\n";
+    std::cout << std::setw(12) << "rects" << std::setw(14) << "JSON (MB)" << std::setw(14) << "parse (ms)" << std::setw(14) << "binary (MB)"
+              << std::setw(14) << "load (ms)" << std::setw(12) << "speedup" << "\n";
+    for (size_t count : {10000u, 100000u, 1000000u})
+    {
+        auto rects = uniform_scene(count, static_cast<uint32_t>(count));
+        string json = to_json(rects);
+        string binary = binary_rects_document(rects);
+        double parse = best_time_ms([&]()
+                                    { parse_rects(json, SIZE_MAX); });
+        double load = best_time_ms([&]()
+                                   { read_binary_rects(binary, SIZE_MAX); });
+        std::cout << std::fixed << std::setprecision(2) << std::setw(12) << count << std::setw(14) << json.size() / 1e6 << std::setw(14) << parse
+                  << std::setw(14) << binary.size() / 1e6 << std::setw(14) << load << std::setw(11) << parse / load << "x\n";
+    }
+}
+
+// Scenes of repeated rectangles: the plain stream walks every subset of the copies, the class stream one set per group of classes
+void bench_duplicate_classes()
+{
+    std::cout << "--> Enumeration with identical rectangles collapsed into classes\n";
+    std::cout << std::setw(24) << "scene" << std::setw(16) << "intersections" << std::setw(14) << "plain (ms)" << std::setw(12) << "classes"
+              << std::setw(14) << "classes (ms)" << std::setw(12) << "speedup" << "\n";
+    auto row = [](const string &name, const vector<Rectangle> &distinct, size_t copies)
+    {
+        vector<Rectangle> rects;
+        for (size_t i = 0; i < copies; i += 1)
+        {
+            rects.insert(rects.end(), distinct.begin(), distinct.end());
+        }
+        size_t found = 0;
+        size_t collapsed = 0;
+        double plain = best_time_ms([&]()
+                                    {
+            found = 0;
+            for (IntersectionStream stream(rects); stream.next().has_value();)
+            {
+                found += 1;
+            } });
+        double classes = best_time_ms([&]()
+                                      {
+            collapsed = 0;
+            DuplicateClasses<uint32_t> duplicates(rects);
+            for (ClassIntersectionStream<uint32_t> stream(duplicates); stream.next().has_value();)
+            {
+                collapsed += 1;
+            } });
+        std::cout << std::fixed << std::setprecision(3) << std::setw(24) << name << std::setw(16) << found << std::setw(14) << plain
+                  << std::setw(12) << collapsed << std::setw(14) << classes << std::setw(11) << plain / classes << "x\n";
+    };
+    row("4 overlapping x 4", all_overlapping(4, 4), 4);
+    row("5 overlapping x 4", all_overlapping(5, 5), 4);
+    row("uniform 2000 x 2", uniform_scene(2000, 2000), 2);
+    row("uniform 500 x 3", uniform_scene(500, 500), 3);
+}
+
+struct SceneResult
+{
+    string scene;
+    size_t size = 0;
+    uint32_t seed = 0;
+    size_t pairs = 0;
+    size_t intersections = 0;
+    // the enumeration stopped at SCENE_INTERSECTION_LIMIT
+    bool truncated = false;
+    double parse_ms = 0, pairs_ms = 0, enumerate_ms = 0, output_ms = 0;
+};
+
+// Enumeration stops after this many intersections, some scenes have exponentially many
+constexpr size_t SCENE_INTERSECTION_LIMIT = 1000000;
+
+// Times each phase of main on one generated scene: parsing its JSON, the broad phase,
+// the enumeration of the intersections from the pairs, and writing them in the Text format
+SceneResult run_scene(const string &name, const vector<Rectangle> &rects, uint32_t seed)
+{
+    SceneResult result{.scene = name, .size = rects.size(), .seed = seed};
+    string json = to_json(rects);
+    result.parse_ms = best_time_ms([&]()
+                                   { parse_rects(json, rects.size()); });
+
+    vector<std::pair<Id, Id>> pairs;
+    result.pairs_ms = best_time_ms([&]()
+                                   { pairs = Intersection::overlapping_pairs(rects); });
+    result.pairs = pairs.size();
+
+    vector<Intersection> found;
+    result.enumerate_ms = best_time_ms([&]()
+                                       {
+                                           found.clear();
+                                           for (IntersectionStream stream(rects, pairs, {}); found.size() < SCENE_INTERSECTION_LIMIT;)
+                                           {
+                                               auto inter = stream.next();
+                                               if (!inter.has_value())
+                                               {
+                                                   break;
+                                               }
+                                               found.push_back(std::move(*inter));
+                                           } });
+    result.intersections = found.size();
+    result.truncated = found.size() == SCENE_INTERSECTION_LIMIT;
+
+    NullBuffer null_buffer;
+    std::ostream null_stream(&null_buffer);
+    result.output_ms = best_time_ms([&]()
+                                    {
+                                        OutputWriter writer(null_stream, OutputFormat::Text);
+                                        writer.write_inputs(rects);
+                                        writer.begin_intersections("Intersections");
+                                        for (const Intersection &inter : found)
+                                        {
+                                            writer.write(inter);
+                                        }
+                                        writer.end_intersections(); });
+    return result;
+}
+
+void write_scene_results(std::ostream &os, const vector<SceneResult> &results)
+{
+    os << std::fixed << std::setprecision(4);
+    os << "{\"isa\":\"" << isa_name(best_isa()) << "\",\"hardware_threads\":" << std::thread::hardware_concurrency()
+       << ",\"intersection_limit\":" << SCENE_INTERSECTION_LIMIT << ",\"results\":[";
+    for (size_t i = 0; i < results.size(); i += 1)
+    {
+        const SceneResult &r = results[i];
+        os << (i == 0 ? "\n" : ",\n")
+           << "{\"scene\":\"" << r.scene << "\",\"size\":" << r.size << ",\"seed\":" << r.seed
+           << ",\"pairs\":" << r.pairs << ",\"intersections\":" << r.intersections << ",\"truncated\":" << (r.truncated ? "true" : "false")
+           << ",\"parse_ms\":" << r.parse_ms << ",\"pairs_ms\":" << r.pairs_ms
+           << ",\"enumerate_ms\":" << r.enumerate_ms << ",\"output_ms\":" << r.output_ms << "}";
+    }
+    os << "\n]}\n";
+}
+
+// End to end phases of every scene at every size. Results are also written as JSON to json_path, unless it is empty
+void bench_scenes(const string &json_path)
+{
+    struct Scene
+    {
+        string name;
+        // every subset of an all-overlap scene is an intersection, and past 100 rectangles
+        // the ones found before the limit have so many ids that writing them takes minutes
+        size_t max_size;
+        std::function<vector<Rectangle>(size_t, uint32_t)> generate;
+    };
+    const vector<Scene> scenes = {
+        {"uniform", SIZE_MAX, [](size_t count, uint32_t seed)
+         { return uniform_scene(count, seed); }},
+        {"clustered", SIZE_MAX, clustered_scene},
+        {"nested-stack", SIZE_MAX, nested_stack_scene},
+        {"duplicate", SIZE_MAX, duplicate_scene},
+        {"grid-adjacent", SIZE_MAX, grid_adjacent_scene},
+        {"all-overlap", 100, [](size_t count, uint32_t seed)
+         { return all_overlapping(count, seed); }},
+    };
+
+    std::cout << "--> Phases of generated scenes, best of up to 20 runs (enumeration stops at " << SCENE_INTERSECTION_LIMIT << " intersections)\n";
+    std::cout << std::setw(16) << "scene" << std::setw(8) << "rects" << std::setw(10) << "pairs" << std::setw(10) << "found"
+              << std::setw(12) << "parse (ms)" << std::setw(12) << "pairs (ms)" << std::setw(12) << "enum (ms)" << std::setw(12) << "output (ms)" << "\n";
+    vector<SceneResult> results;
+    for (const Scene &scene : scenes)
+    {
+        for (size_t count : {10, 100, 1000, 10000, 100000})
+        {
+            if (count > scene.max_size)
+            {
+                continue;
+            }
+            uint32_t seed = static_cast<uint32_t>(count);
+            SceneResult r = run_scene(scene.name, scene.generate(count, seed), seed);
+            std::cout << std::fixed << std::setprecision(3)
+                      << std::setw(16) << r.scene << std::setw(8) << r.size << std::setw(10) << r.pairs
+                      << std::setw(10) << (std::to_string(r.intersections) + (r.truncated ? "+" : ""))
+                      << std::setw(12) << r.parse_ms << std::setw(12) << r.pairs_ms << std::setw(12) << r.enumerate_ms << std::setw(12) << r.output_ms << "\n";
+            results.push_back(std::move(r));
+        }
+    }
+    if (!json_path.empty())
+    {
+        std::ofstream json(json_path);
+        write_scene_results(json, results);
+        std::cout << "Scene results written to " << json_path << "\n";
+    }
+}
+
+// ./benchmarks [--scenes] [--json PATH]
+// --scenes only runs the scene suite, --json writes its results to PATH
+int main(int argc, char *argv[])
+{
+    bool scenes_only = false;
+    string json_path;
+    for (int i = 1; i < argc; i += 1)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--scenes")
+        {
+            scenes_only = true;
+        }
+        else if (arg == "--json" && i + 1 < argc)
+        {
+            json_path = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--scenes] [--json PATH]\n";
+            return 1;
+        }
+    }
+    if (scenes_only)
+    {
+        bench_scenes(json_path);
+        return 0;
+    }
+    bench_enumeration();
+    bench_intersect_kernel();
+    bench_engine_kernel();
+    bench_threads();
+    bench_maximal();
+    bench_queries();
+    bench_coverage();
+    bench_rtree();
+    bench_incremental();
+    bench_tree();
+    bench_small_search();
+    bench_binary_input();
+    bench_duplicate_classes();
+    bench_scenes(json_path);
+}
@@ -0,0 +1,39 @@
+#include <numeric>
+#include "canonical_search.hpp"
+
+template <typename T>
+CanonicalSearch<T>::CanonicalSearch(const std::vector<Shape> &inputs, const std::vector<std::pair<Id, Id>> &pairs, const IntersectionOptions &options)
+    : m_inputs(inputs), m_isa(options.isa), m_min_degree(options.min_degree), m_max_degree(options.max_degree), m_row_start(inputs.size() + 2, 0)
+{
+    m_later_neighbours.reserve(pairs.size());
+    m_neighbour_boxes.reserve(pairs.size());
+    for (auto [i, j] : pairs)
+    {
+        m_row_start[i + 1] += 1;
+        m_later_neighbours.push_back(j);
+        m_neighbour_boxes.push_back(inputs[j - 1]);
+    }
+    std::partial_sum(m_row_start.begin(), m_row_start.end(), m_row_start.begin());
+}
+
+template <typename T>
+BasicIntersection<T> CanonicalSearch<T>::seed(Id i, Id j, std::pmr::memory_resource *memory) const
+{
+    // Ids are 1 based
+    return Inter(*m_inputs[i - 1].intersect(m_inputs[j - 1]), IdSet({i, j}, memory));
+}
+
+template <typename T>
+bool CanonicalSearch<T>::within_degree_bounds(const Inter &inter) const
+{
+    return within_degree_bounds(inter.ids().size());
+}
+
+template <typename T>
+bool CanonicalSearch<T>::within_degree_bounds(size_t degree) const
+{
+    return degree >= m_min_degree && degree <= m_max_degree;
+}
+
+#define NITRO_INSTANTIATE_CANONICAL_SEARCH(T) template class CanonicalSearch<T>;
+NITRO_COORDINATE_TYPES(NITRO_INSTANTIATE_CANONICAL_SEARCH)
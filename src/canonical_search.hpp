@@ -0,0 +1,111 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+#include "intersection.hpp"
+#include "rectangle_soa.hpp"
+#include "stats.hpp"
+
+/**
+ * Building blocks of the canonical enumeration (see Enumeration::Canonical), shared by every engine that walks it.
+ *
+ * Every id set is grown in increasing id order only, so it has exactly one path from its first pair and no dedup is needed.
+ * Nothing is lost: if a set of rectangles intersects, so does every subset of it, in particular each of its prefixes.
+ *
+ * An id that can extend an intersection must at least overlap its largest id,
+ * so candidates come from that id's neighbours in the pair list rather than from all the inputs.
+ * The boxes of each id's neighbours are stored contiguously, so one intersect_batch call clips the shape against all of them.
+ * Short rows are tested one by one, as setting up a batch costs more than it saves there.
+ *
+ * The degree bounds of the options are applied here as well: intersections at max_degree are not extended,
+ * and engines only report the ones within_degree_bounds.
+ */
+template <typename T>
+class CanonicalSearch
+{
+    using Shape = BasicRectangle<T>;
+    using Inter = BasicIntersection<T>;
+
+    // Neighbour rows shorter than this skip intersect_batch
+    static constexpr size_t MIN_BATCH_SIZE = 32;
+
+    const std::vector<Shape> &m_inputs;
+    Isa m_isa;
+    size_t m_min_degree;
+    size_t m_max_degree;
+    // For each id i, the greater ids it overlaps are m_later_neighbours[m_row_start[i]..m_row_start[i + 1]).
+    // Pairs are sorted, so every row is too. m_neighbour_boxes holds their boxes in the same order
+    std::vector<size_t> m_row_start;
+    std::vector<Id> m_later_neighbours;
+    BasicRectangleSoA<T> m_neighbour_boxes;
+
+public:
+    // Scratch space of intersect_batch, one per thread
+    struct Scratch
+    {
+        BasicRectangleSoA<T> clipped;
+        std::vector<uint64_t> hits;
+        // where the id sets of the extensions are allocated
+        std::pmr::memory_resource *memory = std::pmr::get_default_resource();
+
+        Scratch() = default;
+        explicit Scratch(std::pmr::memory_resource *memory) : memory(memory) {}
+    };
+
+    // pairs as returned by BasicIntersection::overlapping_pairs. Uses the isa and degree bounds of options
+    CanonicalSearch(const std::vector<Shape> &inputs, const std::vector<std::pair<Id, Id>> &pairs, const IntersectionOptions &options);
+
+    // The 1st degree intersection of a pair from the pair list, with its ids allocated from memory
+    Inter seed(Id i, Id j, std::pmr::memory_resource *memory = std::pmr::get_default_resource()) const;
+
+    bool within_degree_bounds(const Inter &inter) const;
+    bool within_degree_bounds(size_t degree) const;
+
+    // Calls push(BasicIntersection<T>) on every canonical extension of inter, largest added id first
+    template <typename Push>
+    void extend(const Inter &inter, Scratch &scratch, Push &&push) const
+    {
+        extend(inter.shape(), inter.ids().max(), inter.ids().size(), scratch, [&](Id id, const Shape &shape)
+               {
+                   IdSet new_ids(inter.ids(), scratch.memory);
+                   new_ids.insert(id);
+                   push(Inter(shape, std::move(new_ids))); });
+    }
+
+    // Same as above for an intersection of `degree` ids with largest id `last`, without its id set:
+    // calls push(Id, const BasicRectangle<T> &) with the added id and the extension's shape
+    template <typename Push>
+    void extend(const Shape &shape, Id last, size_t degree, Scratch &scratch, Push &&push) const
+    {
+        if (degree >= m_max_degree)
+        {
+            return;
+        }
+        size_t row = m_row_start[last];
+        size_t row_size = m_row_start[last + 1] - row;
+        NITRO_COUNT(extension_attempts, row_size);
+        if (row_size >= MIN_BATCH_SIZE)
+        {
+            intersect_batch(shape, m_neighbour_boxes, row, row_size, scratch.clipped, scratch.hits, m_isa);
+            for (size_t k = row_size; k > 0; k -= 1)
+            {
+                if ((scratch.hits[(k - 1) / 64] >> ((k - 1) % 64) & 1) != 0)
+                {
+                    push(m_later_neighbours[row + k - 1], scratch.clipped.get(k - 1));
+                }
+            }
+        }
+        else
+        {
+            for (size_t k = row_size; k > 0; k -= 1)
+            {
+                Id id = m_later_neighbours[row + k - 1];
+                auto new_shape = shape.intersect(m_inputs[id - 1]);
+                if (new_shape.has_value())
+                {
+                    push(id, *new_shape);
+                }
+            }
+        }
+    }
+};
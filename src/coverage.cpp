@@ -0,0 +1,285 @@
+#include <algorithm>
+#include "coverage.hpp"
+
+namespace
+{
+
+// A side of a rectangle along the sweep: its y range [y, y2) as indices into the compressed y coordinates
+template <typename T>
+struct Edge
+{
+    T x;
+    size_t y;
+    size_t y2;
+    int delta;
+};
+
+// Sides and compressed y coordinates of every rectangle that can overlap something
+template <typename T>
+struct Sweep
+{
+    std::vector<Edge<T>> edges;
+    std::vector<T> ys;
+
+    explicit Sweep(const std::vector<BasicRectangle<T>> &rects)
+    {
+        std::vector<const BasicRectangle<T> *> kept;
+        for (const BasicRectangle<T> &rect : rects)
+        {
+            // empty, or wrapping around (see coverage_stats)
+            if (rect.x_end() <= rect.m_x || rect.y_end() <= rect.m_y)
+            {
+                continue;
+            }
+            kept.push_back(&rect);
+            ys.push_back(rect.m_y);
+            ys.push_back(rect.y_end());
+        }
+        std::sort(ys.begin(), ys.end());
+        ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+        auto index = [this](T y)
+        {
+            return static_cast<size_t>(std::lower_bound(ys.begin(), ys.end(), y) - ys.begin());
+        };
+        for (const BasicRectangle<T> *rect : kept)
+        {
+            size_t y = index(rect->m_y);
+            size_t y2 = index(rect->y_end());
+            edges.push_back(Edge<T>{.x = rect->m_x, .y = y, .y2 = y2, .delta = 1});
+            edges.push_back(Edge<T>{.x = rect->x_end(), .y = y, .y2 = y2, .delta = -1});
+        }
+        // closing sides first, so rectangles that only touch are never counted as stacked
+        std::sort(edges.begin(), edges.end(), [](const Edge<T> &lhs, const Edge<T> &rhs)
+                  { return lhs.x < rhs.x || (lhs.x == rhs.x && lhs.delta < rhs.delta); });
+    }
+
+    // The elementary intervals [ys[i], ys[i + 1])
+    size_t intervals() const
+    {
+        return ys.empty() ? 0 : ys.size() - 1;
+    }
+};
+
+// Range add, global max: the depth of the deepest point of the sweep line
+template <typename T>
+class DepthTree
+{
+    size_t m_size;
+    std::vector<int64_t> m_add;
+    std::vector<int64_t> m_max;
+
+    void update(size_t node, size_t lo, size_t hi, size_t y, size_t y2, int delta)
+    {
+        if (y2 <= lo || hi <= y)
+        {
+            return;
+        }
+        if (y <= lo && hi <= y2)
+        {
+            m_add[node] += delta;
+            m_max[node] += delta;
+            return;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        update(2 * node, lo, mid, y, y2, delta);
+        update(2 * node + 1, mid, hi, y, y2, delta);
+        m_max[node] = m_add[node] + std::max(m_max[2 * node], m_max[2 * node + 1]);
+    }
+
+public:
+    explicit DepthTree(size_t intervals) : m_size(intervals), m_add(4 * intervals + 4, 0), m_max(4 * intervals + 4, 0) {}
+
+    void update(const Edge<T> &edge)
+    {
+        update(1, 0, m_size, edge.y, edge.y2, edge.delta);
+    }
+
+    int64_t max() const
+    {
+        return m_max[1];
+    }
+};
+
+/**
+ * Every node holds how many edges cover its whole range (only counted there, not in its children), the largest depth
+ * reached in its range by the edges stored below it, and its row: for each depth j, the length of its range covered
+ * at least j times by those edges. A child covered c times has its whole length at depth j <= c, and its row's length
+ * at depth j - c above that, so an update only rebuilds the rows along its path, up to their current depth.
+ *
+ * Rows are sized by the edges that can ever be stored below a node: those that cross its range without covering it,
+ * which have an end inside it. Each edge crosses at most two nodes per level, so all rows together hold at most
+ * min(levels, 2n log n) lengths, where the dense table of every depth at every node would hold (4n + 4) * levels.
+ */
+template <typename T>
+class CoverageTree
+{
+    const std::vector<T> &m_ys;
+    size_t m_size;
+    std::vector<uint32_t> m_cover;
+    std::vector<uint32_t> m_depth;
+    // The row of node is m_rows[m_start[node]..m_start[node + 1]), depth j at index j - 1.
+    // Lengths fit in T: a node's range is at most the span of the y coordinates, whose ends all fit in T
+    std::vector<size_t> m_start;
+    std::vector<T> m_rows;
+
+    size_t capacity(size_t node) const
+    {
+        return m_start[node + 1] - m_start[node];
+    }
+
+    // Length of the range of node covered at least j >= 1 times by its own edges and the ones below it
+    T at_least(size_t node, size_t lo, size_t hi, size_t j) const
+    {
+        if (j <= m_cover[node])
+        {
+            return static_cast<T>(m_ys[hi] - m_ys[lo]);
+        }
+        size_t k = j - m_cover[node];
+        return k <= capacity(node) ? m_rows[m_start[node] + k - 1] : 0;
+    }
+
+    void pull(size_t node, size_t lo, size_t hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t left = 2 * node;
+        size_t right = 2 * node + 1;
+        uint32_t depth = std::max(m_cover[left] + m_depth[left], m_cover[right] + m_depth[right]);
+        // past the old depth too, so the depths given up go back to 0
+        size_t top = std::min(capacity(node), size_t{std::max(depth, m_depth[node])});
+        for (size_t j = 1; j <= top; j += 1)
+        {
+            m_rows[m_start[node] + j - 1] = static_cast<T>(at_least(left, lo, mid, j) + at_least(right, mid, hi, j));
+        }
+        m_depth[node] = depth;
+    }
+
+    void update(size_t node, size_t lo, size_t hi, size_t y, size_t y2, int delta)
+    {
+        if (y2 <= lo || hi <= y)
+        {
+            return;
+        }
+        if (y <= lo && hi <= y2)
+        {
+            m_cover[node] += delta;
+            return;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        update(2 * node, lo, mid, y, y2, delta);
+        update(2 * node + 1, mid, hi, y, y2, delta);
+        pull(node, lo, hi);
+    }
+
+    // Counts in crossing[node] the edges [y, y2) would be stored below node
+    void count_crossing(size_t node, size_t lo, size_t hi, size_t y, size_t y2, std::vector<size_t> &crossing) const
+    {
+        if (y2 <= lo || hi <= y || (y <= lo && hi <= y2))
+        {
+            return;
+        }
+        crossing[node] += 1;
+        size_t mid = lo + (hi - lo) / 2;
+        count_crossing(2 * node, lo, mid, y, y2, crossing);
+        count_crossing(2 * node + 1, mid, hi, y, y2, crossing);
+    }
+
+public:
+    // edges must be those of sweep, levels the deepest row anyone asks covered() for
+    CoverageTree(const std::vector<T> &ys, const std::vector<Edge<T>> &edges, size_t intervals, size_t levels)
+        : m_ys(ys), m_size(intervals), m_cover(4 * intervals + 4, 0), m_depth(4 * intervals + 4, 0), m_start(4 * intervals + 5, 0)
+    {
+        std::vector<size_t> crossing(4 * intervals + 4, 0);
+        for (const Edge<T> &edge : edges)
+        {
+            if (edge.delta > 0)
+            {
+                count_crossing(1, 0, m_size, edge.y, edge.y2, crossing);
+            }
+        }
+        for (size_t node = 0; node < crossing.size(); node += 1)
+        {
+            m_start[node + 1] = m_start[node] + std::min(levels, crossing[node]);
+        }
+        m_rows.assign(m_start.back(), 0);
+    }
+
+    void update(const Edge<T> &edge)
+    {
+        update(1, 0, m_size, edge.y, edge.y2, edge.delta);
+    }
+
+    // Deepest point of the sweep line
+    size_t depth() const
+    {
+        return m_cover[1] + m_depth[1];
+    }
+
+    // Length of the sweep line covered at least j >= 1 times
+    uint64_t covered(size_t j) const
+    {
+        return at_least(1, 0, m_size, j);
+    }
+};
+
+} // namespace
+
+std::string area_digits(CoverageArea area)
+{
+    std::string digits;
+    do
+    {
+        digits.push_back(static_cast<char>('0' + area % 10));
+        area /= 10;
+    } while (area != 0);
+    return std::string(digits.rbegin(), digits.rend());
+}
+
+template <typename T>
+CoverageStats coverage_stats(const std::vector<BasicRectangle<T>> &rects, size_t levels)
+{
+    CoverageStats stats;
+    Sweep<T> sweep(rects);
+    DepthTree<T> depth(sweep.intervals());
+    int64_t max_depth = 0;
+    for (const Edge<T> &edge : sweep.edges)
+    {
+        depth.update(edge);
+        max_depth = std::max(max_depth, depth.max());
+    }
+    stats.max_depth = static_cast<size_t>(max_depth);
+    stats.levels = std::min(stats.max_depth, levels);
+    stats.area_at_least.assign(stats.levels + 1, 0);
+    stats.depth_area.assign(stats.levels + 1, 0);
+    if (stats.levels == 0)
+    {
+        return stats;
+    }
+
+    CoverageTree<T> tree(sweep.ys, sweep.edges, sweep.intervals(), stats.levels);
+    T x = sweep.edges.front().x;
+    for (const Edge<T> &edge : sweep.edges)
+    {
+        if (edge.x != x)
+        {
+            // nothing is covered deeper than the sweep line goes
+            size_t top = std::min(stats.levels, tree.depth());
+            for (size_t j = 1; j <= top; j += 1)
+            {
+                stats.area_at_least[j] += CoverageArea{tree.covered(j)} * static_cast<uint64_t>(edge.x - x);
+            }
+            x = edge.x;
+        }
+        tree.update(edge);
+    }
+
+    for (size_t j = 1; j < stats.levels; j += 1)
+    {
+        stats.depth_area[j] = stats.area_at_least[j] - stats.area_at_least[j + 1];
+    }
+    stats.depth_area[stats.levels] = stats.area_at_least[stats.levels];
+    return stats;
+}
+
+template CoverageStats coverage_stats(const std::vector<BasicRectangle<uint16_t>> &rects, size_t levels);
+template CoverageStats coverage_stats(const std::vector<BasicRectangle<uint32_t>> &rects, size_t levels);
+template CoverageStats coverage_stats(const std::vector<BasicRectangle<uint64_t>> &rects, size_t levels);
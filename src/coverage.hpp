@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "rectangle.hpp"
+
+// Areas of the plane. Range ends go up to 2^33 once parsed uint32_t coordinates are widened to uint64_t,
+// so a covered area can reach 2^66 and overflow uint64_t
+using CoverageArea = unsigned __int128;
+
+// Decimal digits of area, which iostreams and std::to_chars don't print
+std::string area_digits(CoverageArea area);
+
+// How much of the plane is covered how many times
+struct CoverageStats
+{
+    // Largest number of rectangles over a single point, the degree of the largest intersection
+    size_t max_depth = 0;
+    // Number of depths below tracked exactly: min(max_depth, the levels asked for)
+    size_t levels = 0;
+    // area_at_least[k] is the area covered by k rectangles or more, for k in 1..levels. [0] is unused and left at 0
+    std::vector<CoverageArea> area_at_least;
+    // depth_area[k] is the area covered by exactly k rectangles, for k in 1..levels - 1.
+    // depth_area[levels] is the area covered by levels rectangles or more. [0] is unused and left at 0
+    std::vector<CoverageArea> depth_area;
+};
+
+/**
+ * Coverage of the plane by the rectangles, computed without enumerating a single intersection.
+ *
+ * A sweep along x over the compressed y coordinates keeps a segment tree where every node holds, for each depth j up to
+ * `levels`, the length of its range covered at least j times (Klee's measure, one level per depth). A node only keeps a
+ * row for the depths the rectangles crossing its range can stack up to, so memory is O(n log n) lengths whatever `levels`
+ * is, and an update walks each node of its path up to the depth actually reached there: O(n log n) time on shallow scenes,
+ * O(n log n * levels) at worst. Deep inputs can cap `levels` and still get max_depth and the coarser buckets.
+ *
+ * Like the sweep broad phase, rectangles whose x or y range wraps around T are left out:
+ * BasicRectangle::intersect never lets them overlap anything. Run it on narrowest_coordinates, like the engines,
+ * so no rectangle wraps. Areas are summed as CoverageArea whatever T is, so they never wrap around either.
+ * Instantiated for the unsigned coordinate types the loader chooses from: uint16_t, uint32_t and uint64_t.
+ */
+template <typename T>
+CoverageStats coverage_stats(const std::vector<BasicRectangle<T>> &rects, size_t levels = SIZE_MAX);
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include "duplicate_classes.hpp"
+
+template <typename T>
+DuplicateClasses<T>::DuplicateClasses(const std::vector<BasicRectangle<T>> &rects)
+{
+    // Sorted by rectangle then by id, identical rectangles end up next to each other with their ids in order
+    std::vector<Id> order(rects.size());
+    std::iota(order.begin(), order.end(), Id{1});
+    std::sort(order.begin(), order.end(), [&rects](Id lhs, Id rhs)
+              {
+                  const auto &l = rects[lhs - 1];
+                  const auto &r = rects[rhs - 1];
+                  return std::tie(l.m_x, l.m_y, l.m_w, l.m_h, lhs) < std::tie(r.m_x, r.m_y, r.m_w, r.m_h, rhs); });
+
+    // [begin, end) of each run of identical rectangles in order, then sorted by the smallest id of the run
+    std::vector<std::pair<size_t, size_t>> runs;
+    for (size_t begin = 0; begin < order.size();)
+    {
+        size_t end = begin + 1;
+        while (end < order.size() && rects[order[end] - 1] == rects[order[begin] - 1])
+        {
+            end += 1;
+        }
+        runs.emplace_back(begin, end);
+        begin = end;
+    }
+    std::sort(runs.begin(), runs.end(), [&order](const auto &lhs, const auto &rhs)
+              { return order[lhs.first] < order[rhs.first]; });
+
+    m_representatives.reserve(runs.size());
+    m_ids.reserve(order.size());
+    m_start.reserve(runs.size() + 1);
+    for (auto [begin, end] : runs)
+    {
+        m_start.push_back(m_ids.size());
+        m_representatives.push_back(rects[order[begin] - 1]);
+        m_ids.insert(m_ids.end(), order.begin() + begin, order.begin() + end);
+    }
+    m_start.push_back(m_ids.size());
+}
+
+template <typename T>
+size_t DuplicateClasses<T>::size() const
+{
+    return m_representatives.size();
+}
+
+template <typename T>
+const std::vector<BasicRectangle<T>> &DuplicateClasses<T>::representatives() const
+{
+    return m_representatives;
+}
+
+template <typename T>
+std::span<const Id> DuplicateClasses<T>::ids(size_t class_index) const
+{
+    return std::span<const Id>(m_ids).subspan(m_start[class_index], m_start[class_index + 1] - m_start[class_index]);
+}
+
+template <typename T>
+ClassIntersectionStream<T>::ClassIntersectionStream(const DuplicateClasses<T> &classes)
+    : m_classes(classes), m_stream(classes.representatives()) {}
+
+template <typename T>
+std::optional<ClassIntersection<T>> ClassIntersectionStream<T>::next()
+{
+    while (m_next_single < m_classes.size() && m_classes.ids(m_next_single).size() < 2)
+    {
+        m_next_single += 1;
+    }
+    if (!m_pending.has_value() && !m_stream_done)
+    {
+        m_pending = m_stream.next();
+        m_stream_done = !m_pending.has_value();
+    }
+    // A single class comes before every set that starts with it, representative ids being class indices + 1
+    bool single_first = m_next_single < m_classes.size() &&
+                        (!m_pending.has_value() || m_next_single < *m_pending->ids().begin());
+    if (single_first)
+    {
+        size_t single = m_next_single;
+        m_next_single += 1;
+        return ClassIntersection<T>{.shape = m_classes.representatives()[single], .classes = {single}};
+    }
+    if (!m_pending.has_value())
+    {
+        return std::nullopt;
+    }
+    ClassIntersection<T> inter{.shape = m_pending->shape(), .classes = {}};
+    for (Id id : m_pending->ids())
+    {
+        inter.classes.push_back(id - 1);
+    }
+    m_pending.reset();
+    return inter;
+}
+
+template <typename T>
+ClassExpansion<T>::ClassExpansion(const DuplicateClasses<T> &classes, ClassIntersection<T> inter)
+    : m_classes(classes), m_inter(std::move(inter))
+{
+    for (size_t class_index : m_inter.classes)
+    {
+        std::vector<bool> chosen(m_classes.ids(class_index).size(), false);
+        chosen[0] = true;
+        m_chosen.push_back(std::move(chosen));
+    }
+}
+
+template <typename T>
+bool ClassExpansion<T>::advance()
+{
+    // The last class counts fastest. A counter that wraps around to 0 starts over at 1 and carries into the previous class
+    for (size_t k = m_chosen.size(); k > 0; k -= 1)
+    {
+        std::vector<bool> &chosen = m_chosen[k - 1];
+        size_t bit = 0;
+        for (; bit < chosen.size() && chosen[bit]; bit += 1)
+        {
+            chosen[bit] = false;
+        }
+        if (bit < chosen.size())
+        {
+            chosen[bit] = true;
+            return true;
+        }
+        chosen[0] = true;
+    }
+    return false;
+}
+
+template <typename T>
+std::optional<BasicIntersection<T>> ClassExpansion<T>::next()
+{
+    while (!m_done)
+    {
+        IdSet ids;
+        for (size_t k = 0; k < m_chosen.size(); k += 1)
+        {
+            auto class_ids = m_classes.ids(m_inter.classes[k]);
+            for (size_t i = 0; i < class_ids.size(); i += 1)
+            {
+                if (m_chosen[k][i])
+                {
+                    ids.insert(class_ids[i]);
+                }
+            }
+        }
+        m_done = !advance();
+        // a single class yields its lone rectangles too, they are not intersections
+        if (ids.size() >= 2)
+        {
+            return BasicIntersection<T>(m_inter.shape, std::move(ids));
+        }
+    }
+    return std::nullopt;
+}
+
+#define NITRO_INSTANTIATE_CLASSES(T)          \
+    template class DuplicateClasses<T>;       \
+    template class ClassIntersectionStream<T>; \
+    template class ClassExpansion<T>;
+NITRO_COORDINATE_TYPES(NITRO_INSTANTIATE_CLASSES)
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+#include "intersection.hpp"
+#include "intersection_stream.hpp"
+
+/**
+ * Identical input rectangles grouped into classes.
+ *
+ * Every subset of identical rectangles intersects in the same shape, so k copies of a rectangle multiply the output by up to
+ * 2^k - 1 without adding a single new region. The engines can walk one representative per class instead, see ClassIntersectionStream.
+ * Classes are numbered in the order of their smallest ids, so sets of classes sort like the id sets of those smallest ids.
+ */
+template <typename T>
+class DuplicateClasses
+{
+    std::vector<BasicRectangle<T>> m_representatives;
+    // The ids of class k are m_ids[m_start[k]..m_start[k + 1]), in increasing order
+    std::vector<Id> m_ids;
+    std::vector<size_t> m_start;
+
+public:
+    explicit DuplicateClasses(const std::vector<BasicRectangle<T>> &rects);
+
+    // Number of classes
+    size_t size() const;
+    // One rectangle per class, class k at index k
+    const std::vector<BasicRectangle<T>> &representatives() const;
+    // The ids of a class, in increasing order
+    std::span<const Id> ids(size_t class_index) const;
+};
+
+/**
+ * A set of classes whose representatives intersect. It stands for every intersection of the inputs that takes at least one
+ * rectangle of each class and two or more in all: they all have this shape. A single class stands for the subsets of its duplicates.
+ */
+template <typename T>
+struct ClassIntersection
+{
+    BasicRectangle<T> shape;
+    // 0-based class indices, in increasing order
+    std::vector<size_t> classes;
+};
+
+/**
+ * The intersections of the inputs compressed into ClassIntersections, in the order of std::set<ClassIntersection::classes>.
+ * The canonical enumeration runs on the representatives only, single threaded, and the classes of two or more duplicates
+ * are merged in on their own. The classes must outlive the stream.
+ */
+template <typename T>
+class ClassIntersectionStream
+{
+    const DuplicateClasses<T> &m_classes;
+    BasicIntersectionStream<T> m_stream;
+    // The next intersection of representatives, not yielded yet
+    std::optional<BasicIntersection<T>> m_pending;
+    bool m_stream_done = false;
+    // The next class that may be yielded on its own
+    size_t m_next_single = 0;
+
+public:
+    explicit ClassIntersectionStream(const DuplicateClasses<T> &classes);
+
+    // The next class intersection, std::nullopt once they have all been yielded
+    std::optional<ClassIntersection<T>> next();
+};
+
+/**
+ * Expands a ClassIntersection back into the intersections of the inputs it stands for, one at a time:
+ * every choice of a non empty subset of each of its classes, two rectangles or more in all, in no particular order.
+ * The classes must outlive the expansion.
+ */
+template <typename T>
+class ClassExpansion
+{
+    const DuplicateClasses<T> &m_classes;
+    ClassIntersection<T> m_inter;
+    // For each class, the ids of it that are chosen, as a binary counter over DuplicateClasses::ids that never reaches 0
+    std::vector<std::vector<bool>> m_chosen;
+    bool m_done = false;
+
+    // Moves to the next choice, and returns false once every one has been made
+    bool advance();
+
+public:
+    ClassExpansion(const DuplicateClasses<T> &classes, ClassIntersection<T> inter);
+
+    // The next intersection, std::nullopt once they have all been yielded
+    std::optional<BasicIntersection<T>> next();
+};
@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include "id_set.hpp"
+
+IdSet::IdSet(std::pmr::memory_resource *memory) : m_spill(memory) {}
+
+IdSet::IdSet(const IdSet &other, std::pmr::memory_resource *memory)
+    : m_inline(other.m_inline), m_spill(other.m_spill, memory) {}
+
+IdSet::IdSet(std::initializer_list<Id> ids, std::pmr::memory_resource *memory) : m_spill(memory)
+{
+    for (Id id : ids)
+    {
+        insert(id);
+    }
+}
+
+IdSet IdSet::from_bits(uint64_t bits)
+{
+    IdSet set;
+    set.m_inline = bits;
+    return set;
+}
+
+std::pmr::vector<IdSet::Word>::const_iterator IdSet::find_word(size_t index) const
+{
+    return std::lower_bound(m_spill.begin(), m_spill.end(), index, [](const Word &w, size_t i)
+                            { return w.index < i; });
+}
+
+void IdSet::insert(Id id)
+{
+    // Ids are 1-based
+    assert(id > 0);
+    size_t bit = id - 1;
+    size_t index = bit / WORD_BITS;
+    uint64_t mask = uint64_t{1} << (bit % WORD_BITS);
+    if (index == 0)
+    {
+        m_inline |= mask;
+        return;
+    }
+    // ids usually arrive in increasing order, which only ever touches the last word
+    if (m_spill.empty() || m_spill.back().index < index)
+    {
+        m_spill.push_back(Word{.index = index, .bits = mask});
+        return;
+    }
+    auto it = m_spill.begin() + (find_word(index) - m_spill.cbegin());
+    if (it->index == index)
+    {
+        it->bits |= mask;
+    }
+    else
+    {
+        m_spill.insert(it, Word{.index = index, .bits = mask});
+    }
+}
+
+void IdSet::erase(Id id)
+{
+    if (!contains(id))
+    {
+        return;
+    }
+    size_t bit = id - 1;
+    size_t index = bit / WORD_BITS;
+    uint64_t mask = uint64_t{1} << (bit % WORD_BITS);
+    if (index == 0)
+    {
+        m_inline &= ~mask;
+        return;
+    }
+    auto it = m_spill.begin() + (find_word(index) - m_spill.cbegin());
+    it->bits &= ~mask;
+    // zero words are never stored
+    if (it->bits == 0)
+    {
+        m_spill.erase(it);
+    }
+}
+
+bool IdSet::contains(Id id) const
+{
+    if (id == 0)
+    {
+        return false;
+    }
+    size_t bit = id - 1;
+    size_t index = bit / WORD_BITS;
+    uint64_t mask = uint64_t{1} << (bit % WORD_BITS);
+    if (index == 0)
+    {
+        return (m_inline & mask) != 0;
+    }
+    auto it = find_word(index);
+    return it != m_spill.end() && it->index == index && (it->bits & mask) != 0;
+}
+
+size_t IdSet::size() const
+{
+    size_t count = std::popcount(m_inline);
+    for (const Word &w : m_spill)
+    {
+        count += std::popcount(w.bits);
+    }
+    return count;
+}
+
+bool IdSet::empty() const
+{
+    return m_inline == 0 && m_spill.empty();
+}
+
+Id IdSet::max() const
+{
+    if (!m_spill.empty())
+    {
+        const Word &last = m_spill.back();
+        return last.index * WORD_BITS + (WORD_BITS - std::countl_zero(last.bits));
+    }
+    return WORD_BITS - std::countl_zero(m_inline);
+}
+
+bool IdSet::is_subset_of(const IdSet &other) const
+{
+    if ((m_inline & ~other.m_inline) != 0)
+    {
+        return false;
+    }
+    auto it = other.m_spill.begin();
+    for (const Word &w : m_spill)
+    {
+        while (it != other.m_spill.end() && it->index < w.index)
+        {
+            ++it;
+        }
+        if (it == other.m_spill.end() || it->index != w.index || (w.bits & ~it->bits) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+IdSet IdSet::operator&(const IdSet &other) const
+{
+    IdSet result;
+    result.m_inline = m_inline & other.m_inline;
+    auto l = m_spill.begin();
+    auto r = other.m_spill.begin();
+    while (l != m_spill.end() && r != other.m_spill.end())
+    {
+        if (l->index < r->index)
+        {
+            ++l;
+        }
+        else if (r->index < l->index)
+        {
+            ++r;
+        }
+        else
+        {
+            if ((l->bits & r->bits) != 0)
+            {
+                result.m_spill.push_back(Word{.index = l->index, .bits = l->bits & r->bits});
+            }
+            ++l;
+            ++r;
+        }
+    }
+    return result;
+}
+
+IdSet IdSet::operator-(const IdSet &other) const
+{
+    IdSet result;
+    result.m_inline = m_inline & ~other.m_inline;
+    auto r = other.m_spill.begin();
+    for (const Word &w : m_spill)
+    {
+        while (r != other.m_spill.end() && r->index < w.index)
+        {
+            ++r;
+        }
+        uint64_t bits = r != other.m_spill.end() && r->index == w.index ? w.bits & ~r->bits : w.bits;
+        if (bits != 0)
+        {
+            result.m_spill.push_back(Word{.index = w.index, .bits = bits});
+        }
+    }
+    return result;
+}
+
+size_t IdSet::common_size(const IdSet &other) const
+{
+    size_t count = std::popcount(m_inline & other.m_inline);
+    auto r = other.m_spill.begin();
+    for (const Word &w : m_spill)
+    {
+        while (r != other.m_spill.end() && r->index < w.index)
+        {
+            ++r;
+        }
+        if (r != other.m_spill.end() && r->index == w.index)
+        {
+            count += std::popcount(w.bits & r->bits);
+        }
+    }
+    return count;
+}
+
+// word-at-a-time mix (the multiply-xorshift step of splitmix64)
+uint64_t IdSet::hash() const
+{
+    auto mix = [](uint64_t h, uint64_t v)
+    {
+        h ^= v;
+        h *= 0xBF58476D1CE4E5B9;
+        return h ^ (h >> 31);
+    };
+    uint64_t h = mix(0x9E3779B97F4A7C15, m_inline);
+    for (const Word &w : m_spill)
+    {
+        h = mix(mix(h, w.index), w.bits);
+    }
+    return h;
+}
+
+IdSet::iterator IdSet::begin() const
+{
+    return iterator(this, 0);
+}
+
+IdSet::iterator IdSet::end() const
+{
+    return iterator(this, 1 + m_spill.size());
+}
+
+IdSet::iterator::iterator(const IdSet *set, size_t position)
+    : m_set(set), m_position(position), m_bits(0)
+{
+    load();
+    skip_empty_words();
+}
+
+// position 0 is the inline word, position k the (k-1)th spilled word
+void IdSet::iterator::load()
+{
+    if (m_position == 0)
+    {
+        m_bits = m_set->m_inline;
+    }
+    else if (m_position <= m_set->m_spill.size())
+    {
+        m_bits = m_set->m_spill[m_position - 1].bits;
+    }
+    else
+    {
+        m_bits = 0;
+    }
+}
+
+void IdSet::iterator::skip_empty_words()
+{
+    while (m_bits == 0 && m_position <= m_set->m_spill.size())
+    {
+        m_position += 1;
+        load();
+    }
+}
+
+Id IdSet::iterator::operator*() const
+{
+    size_t index = m_position == 0 ? 0 : m_set->m_spill[m_position - 1].index;
+    return index * WORD_BITS + std::countr_zero(m_bits) + 1;
+}
+
+IdSet::iterator &IdSet::iterator::operator++()
+{
+    // clear the lowest set bit
+    m_bits &= m_bits - 1;
+    skip_empty_words();
+    return *this;
+}
+
+IdSet::iterator IdSet::iterator::operator++(int)
+{
+    iterator copy = *this;
+    ++*this;
+    return copy;
+}
+
+bool IdSet::iterator::operator==(const iterator &other) const
+{
+    return m_position == other.m_position && m_bits == other.m_bits;
+}
+
+bool operator==(const IdSet &lhs, const IdSet &rhs)
+{
+    return lhs.m_inline == rhs.m_inline && lhs.m_spill == rhs.m_spill;
+}
+
+/**
+ * Lexicographic order of the sorted ids, the same order as std::set<Id>.
+ *
+ * Ids below the lowest bit where both sets differ are shared. Say lhs owns that bit (id p) and rhs doesn't:
+ * if rhs has any id above p, its next id is bigger than p, so lhs < rhs. Otherwise rhs is a prefix of lhs, so rhs < lhs.
+ */
+bool operator<(const IdSet &lhs, const IdSet &rhs)
+{
+    // walks the words of both sets by increasing index, the inline word being index 0
+    using Word = IdSet::Word;
+    auto l = lhs.m_spill.begin();
+    auto r = rhs.m_spill.begin();
+    Word lw{.index = 0, .bits = lhs.m_inline};
+    Word rw{.index = 0, .bits = rhs.m_inline};
+    const Word none{.index = SIZE_MAX, .bits = 0};
+    for (;;)
+    {
+        size_t index = std::min(lw.index, rw.index);
+        if (index == SIZE_MAX)
+        {
+            return false;
+        }
+        uint64_t lbits = lw.index == index ? lw.bits : 0;
+        uint64_t rbits = rw.index == index ? rw.bits : 0;
+        // the next word of each side, if this one is consumed
+        Word lnext = lw.index == index ? (l != lhs.m_spill.end() ? *l : none) : lw;
+        Word rnext = rw.index == index ? (r != rhs.m_spill.end() ? *r : none) : rw;
+
+        uint64_t diff = lbits ^ rbits;
+        if (diff != 0)
+        {
+            uint64_t lowest = diff & -diff;
+            bool lhs_owns = (lbits & lowest) != 0;
+            uint64_t other_bits = lhs_owns ? rbits : lbits;
+            const Word &other_next = lhs_owns ? rnext : lnext;
+            // bits strictly above the differing one
+            uint64_t above = ~(lowest | (lowest - 1));
+            bool other_has_more = (other_bits & above) != 0 || other_next.index != SIZE_MAX;
+            return lhs_owns == other_has_more;
+        }
+
+        if (lw.index == index)
+        {
+            lw = lnext;
+            if (l != lhs.m_spill.end())
+            {
+                ++l;
+            }
+        }
+        if (rw.index == index)
+        {
+            rw = rnext;
+            if (r != rhs.m_spill.end())
+            {
+                ++r;
+            }
+        }
+    }
+}
+
+std::ostream &operator<<(std::ostream &os, const IdSet &s)
+{
+    if (s.size() < 2)
+    {
+        os << "{}";
+    }
+    else
+    {
+        for (auto it = s.begin(); it != s.end(); ++it)
+        {
+            if (it == s.begin()) {
+                os << *it;
+            } else if (std::next(it) == s.end())
+            {
+                os << " and " << *it;
+            } else
+            {
+                os << ", " << *it;
+            }
+        }
+    }
+    return os;
+}
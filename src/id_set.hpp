@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <iterator>
+#include <memory_resource>
+#include <vector>
+
+using Id = uintptr_t;
+// Ids index into std::vector<Rectangle>, so they must be able to count every element
+static_assert(sizeof(Id) >= sizeof(size_t));
+
+/**
+ * Set of 1-based rectangle ids, stored as a bitset where id i is bit i - 1.
+ *
+ * The first 64 ids live in an inline word, so the usual inputs (n <= 64) never allocate.
+ * Higher ids spill into a sorted list of the non-zero 64 bit words, tagged with their index.
+ * Memory is bounded by the number of ids rather than by the largest id, which matters for inputs with thousands of rectangles.
+ * Every operation works a whole word at a time.
+ * The spilled words come from a std::pmr::memory_resource, so engines can keep the id sets they work on in an arena.
+ * Copies always go back to the default resource: only moves keep a set in its arena.
+ * Iteration and ordering behave exactly like std::set<Id>: ids in increasing order, sets compared lexicographically.
+ */
+class IdSet
+{
+    static constexpr size_t WORD_BITS = 64;
+
+    struct Word
+    {
+        // ids index * 64 + 1 up to index * 64 + 64
+        size_t index;
+        uint64_t bits;
+
+        bool operator==(const Word &other) const = default;
+    };
+
+    // ids 1..64
+    uint64_t m_inline = 0;
+    // ids 65 and up. Sorted by index, zero words are never stored, so equal sets have equal representations
+    std::pmr::vector<Word> m_spill;
+
+    std::pmr::vector<Word>::const_iterator find_word(size_t index) const;
+
+public:
+    class iterator
+    {
+        const IdSet *m_set;
+        // 0 for the inline word, k for the (k-1)th spilled word
+        size_t m_position;
+        // bits of the current word that have not been visited yet
+        uint64_t m_bits;
+
+        void load();
+        void skip_empty_words();
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Id;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Id;
+
+        iterator(const IdSet *set, size_t position);
+
+        Id operator*() const;
+        iterator &operator++();
+        iterator operator++(int);
+        bool operator==(const iterator &other) const;
+    };
+
+    IdSet() = default;
+    explicit IdSet(std::pmr::memory_resource *memory);
+    IdSet(std::initializer_list<Id> ids, std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+    // A copy of other that spills into memory
+    IdSet(const IdSet &other, std::pmr::memory_resource *memory);
+    // The ids 1..64 of a word laid out like the inline one, id i being bit i - 1. Never allocates
+    static IdSet from_bits(uint64_t bits);
+    template <typename It>
+    IdSet(It first, It last)
+    {
+        for (; first != last; ++first)
+        {
+            insert(*first);
+        }
+    }
+
+    void insert(Id id);
+    void erase(Id id);
+    bool contains(Id id) const;
+
+    size_t size() const;
+    bool empty() const;
+    // Largest id in the set, 0 when empty
+    Id max() const;
+
+    bool is_subset_of(const IdSet &other) const;
+    IdSet operator&(const IdSet &other) const;
+    // ids of this set that are not in other
+    IdSet operator-(const IdSet &other) const;
+    // same as (*this & other).size(), without building the set
+    size_t common_size(const IdSet &other) const;
+    uint64_t hash() const;
+
+    iterator begin() const;
+    iterator end() const;
+
+    friend bool operator==(const IdSet &lhs, const IdSet &rhs);
+    friend bool operator<(const IdSet &lhs, const IdSet &rhs);
+};
+
+bool operator==(const IdSet &lhs, const IdSet &rhs);
+bool operator<(const IdSet &lhs, const IdSet &rhs);
+// Prints "1, 2 and 3", or "{}" for sets that are not intersections (less than 2 ids)
+std::ostream &operator<<(std::ostream &os, const IdSet &s);
+
+template <>
+struct std::hash<IdSet>
+{
+    size_t operator()(const IdSet &s) const { return s.hash(); }
+};
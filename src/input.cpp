@@ -0,0 +1,728 @@
+#include <boost/json/basic_parser_impl.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "input.hpp"
+
+using std::string, std::string_view;
+namespace json = boost::json;
+
+namespace
+{
+
+// Rectangles reserved before parsing. The size of a document says little about how many it holds,
+// so past this the vector grows as usual rather than being sized for the densest possible input
+const size_t RESERVED_RECTS = 1024;
+
+// Same escaping as boost::json::serialize, so error messages quote the input the way the DOM based reader used to
+void append_escaped(string &out, string_view s)
+{
+    static const char *HEX = "0123456789abcdef";
+    out += '"';
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                out += "\\u00";
+                out += HEX[c >> 4];
+                out += HEX[c & 0xf];
+            }
+            else
+            {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+// Same rules as boost::json::value_to<uint32_t>: integers in range, or doubles holding an integer in range
+std::optional<uint32_t> to_uint32(int64_t i)
+{
+    if (i < 0 || i > std::numeric_limits<uint32_t>::max())
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(i);
+}
+
+std::optional<uint32_t> to_uint32(uint64_t u)
+{
+    if (u > std::numeric_limits<uint32_t>::max())
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(u);
+}
+
+std::optional<uint32_t> to_uint32(double d)
+{
+    if (!(d >= 0) || d > std::numeric_limits<uint32_t>::max() || std::trunc(d) != d)
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(d);
+}
+
+/**
+ * boost::json::basic_parser handler that turns the elements of the top level "rects" array into Rectangles as they stream by.
+ *
+ * Depths count open containers: the top level object is depth 1, the "rects" array depth 2 and a rectangle object depth 3.
+ * The JSON text of each element is rebuilt on the side, so invalid ones can be quoted in error messages.
+ */
+class RectsHandler
+{
+    // bits of the fields a rectangle element has
+    enum Field : uint8_t
+    {
+        X = 1,
+        Y = 2,
+        W = 4,
+        H = 8,
+        ALL = X | Y | W | H,
+    };
+
+    size_t m_limit;
+    size_t m_depth = 0;
+    bool m_root_is_object = false;
+    // the next value at depth 1 belongs to the "rects" key
+    bool m_rects_key = false;
+    bool m_rects_is_array = false;
+    // the "rects" array is open
+    bool m_in_rects = false;
+
+    // an element of "rects" within the limit is being read
+    bool m_in_element = false;
+    bool m_element_valid = true;
+    uint8_t m_fields = 0;
+    size_t m_keys = 0;
+    // field of the last key at depth 3, 0 if it isn't one of x, y, w or h
+    uint8_t m_current_field = 0;
+    uint32_t m_x = 0, m_y = 0, m_w = 0, m_h = 0;
+
+    // JSON text of the current element
+    string m_echo;
+    // for every container open within the element: nothing was written in it yet
+    std::vector<bool> m_echo_first;
+    bool m_echo_after_key = false;
+
+    // keys, strings and numbers can be delivered in several parts
+    string m_part;
+
+    string_view take_parts(string_view last)
+    {
+        if (m_part.empty())
+        {
+            return last;
+        }
+        m_part.append(last.data(), last.size());
+        return m_part;
+    }
+
+    void echo_separator()
+    {
+        if (m_echo_after_key)
+        {
+            m_echo_after_key = false;
+        }
+        else if (!m_echo_first.empty())
+        {
+            if (!m_echo_first.back())
+            {
+                m_echo += ',';
+            }
+            m_echo_first.back() = false;
+        }
+    }
+
+    // Called first thing for every value. Returns whether the value is the one of the top level "rects" key
+    bool begin_value()
+    {
+        bool is_rects = false;
+        if (m_depth == 1)
+        {
+            is_rects = m_rects_key;
+            m_rects_key = false;
+            if (is_rects)
+            {
+                // the last "rects" key wins
+                m_rects_is_array = false;
+                m_in_rects = false;
+            }
+        }
+        else if (m_in_rects && m_depth == 2)
+        {
+            begin_element();
+        }
+        if (m_in_element)
+        {
+            echo_separator();
+        }
+        return is_rects;
+    }
+
+    void begin_element()
+    {
+        size_t index = result.rect_count;
+        result.rect_count += 1;
+        m_in_element = index < m_limit;
+        m_element_valid = true;
+        m_fields = 0;
+        m_keys = 0;
+        m_echo.clear();
+        m_echo_first.clear();
+        m_echo_after_key = false;
+    }
+
+    void end_element()
+    {
+        m_in_element = false;
+        // an empty rectangle would trip BasicRectangle's assertion, and take a whole server down with it
+        if (m_element_valid && m_fields == ALL && m_keys == 4 && m_w > 0 && m_h > 0)
+        {
+            result.rects.push_back(Rectangle({.x = m_x, .y = m_y, .w = m_w, .h = m_h}));
+        }
+        else
+        {
+            result.invalid_rects.push_back(m_echo);
+        }
+    }
+
+    void open(char bracket)
+    {
+        if (m_in_element)
+        {
+            m_echo += bracket;
+            m_echo_first.push_back(true);
+        }
+        m_depth += 1;
+    }
+
+    void close(char bracket)
+    {
+        m_depth -= 1;
+        if (m_in_element)
+        {
+            m_echo += bracket;
+            m_echo_first.pop_back();
+            if (m_depth == 2)
+            {
+                end_element();
+            }
+        }
+    }
+
+    void scalar(std::optional<uint32_t> number)
+    {
+        if (!m_in_element)
+        {
+            return;
+        }
+        // the element itself is a scalar
+        if (m_depth == 2)
+        {
+            m_element_valid = false;
+            end_element();
+            return;
+        }
+        if (m_depth == 3)
+        {
+            if (!number.has_value() || m_current_field == 0)
+            {
+                m_element_valid = false;
+                return;
+            }
+            m_fields |= m_current_field;
+            switch (m_current_field)
+            {
+            case X: m_x = *number; break;
+            case Y: m_y = *number; break;
+            case W: m_w = *number; break;
+            case H: m_h = *number; break;
+            }
+        }
+    }
+
+    template <typename N>
+    bool number(N n, string_view text)
+    {
+        begin_value();
+        if (m_in_element)
+        {
+            auto full = take_parts(text);
+            m_echo.append(full.data(), full.size());
+        }
+        m_part.clear();
+        scalar(to_uint32(n));
+        return true;
+    }
+
+public:
+    constexpr static std::size_t max_object_size = std::size_t(-1);
+    constexpr static std::size_t max_array_size = std::size_t(-1);
+    constexpr static std::size_t max_key_size = std::size_t(-1);
+    constexpr static std::size_t max_string_size = std::size_t(-1);
+
+    ParsedInput result;
+
+    explicit RectsHandler(size_t limit)
+        : m_limit(limit)
+    {
+        result.rects.reserve(std::min(limit, RESERVED_RECTS));
+    }
+
+    bool root_is_object() const { return m_root_is_object; }
+    bool rects_is_array() const { return m_rects_is_array; }
+
+    bool on_document_begin(json::error_code &) { return true; }
+    bool on_document_end(json::error_code &) { return true; }
+
+    bool on_object_begin(json::error_code &)
+    {
+        begin_value();
+        if (m_depth == 0)
+        {
+            m_root_is_object = true;
+        }
+        // a field holding an object rather than a number
+        if (m_in_element && m_depth >= 3)
+        {
+            m_element_valid = false;
+        }
+        open('{');
+        return true;
+    }
+
+    bool on_object_end(std::size_t, json::error_code &)
+    {
+        close('}');
+        return true;
+    }
+
+    bool on_array_begin(json::error_code &)
+    {
+        bool is_rects = begin_value();
+        // rectangles are objects, and their fields are numbers
+        if (m_in_element)
+        {
+            m_element_valid = false;
+        }
+        open('[');
+        if (is_rects)
+        {
+            m_rects_is_array = true;
+            m_in_rects = true;
+            result.rects.clear();
+            result.invalid_rects.clear();
+            result.rect_count = 0;
+        }
+        return true;
+    }
+
+    bool on_array_end(std::size_t, json::error_code &)
+    {
+        close(']');
+        if (m_in_rects && m_depth == 1)
+        {
+            m_in_rects = false;
+        }
+        return true;
+    }
+
+    bool on_key_part(json::string_view s, std::size_t, json::error_code &)
+    {
+        m_part.append(s.data(), s.size());
+        return true;
+    }
+
+    bool on_key(json::string_view s, std::size_t, json::error_code &)
+    {
+        string_view key = take_parts(string_view(s.data(), s.size()));
+        if (m_depth == 1)
+        {
+            m_rects_key = key == "rects";
+        }
+        if (m_in_element)
+        {
+            echo_separator();
+            append_escaped(m_echo, key);
+            m_echo += ':';
+            m_echo_after_key = true;
+            if (m_depth == 3)
+            {
+                m_keys += 1;
+                m_current_field = key == "x" ? X : key == "y" ? Y : key == "w" ? W : key == "h" ? H : 0;
+            }
+        }
+        m_part.clear();
+        return true;
+    }
+
+    bool on_string_part(json::string_view s, std::size_t, json::error_code &)
+    {
+        m_part.append(s.data(), s.size());
+        return true;
+    }
+
+    bool on_string(json::string_view s, std::size_t, json::error_code &)
+    {
+        begin_value();
+        if (m_in_element)
+        {
+            append_escaped(m_echo, take_parts(string_view(s.data(), s.size())));
+        }
+        m_part.clear();
+        scalar(std::nullopt);
+        return true;
+    }
+
+    bool on_number_part(json::string_view s, json::error_code &)
+    {
+        m_part.append(s.data(), s.size());
+        return true;
+    }
+
+    bool on_int64(int64_t i, json::string_view s, json::error_code &)
+    {
+        return number(i, string_view(s.data(), s.size()));
+    }
+
+    bool on_uint64(uint64_t u, json::string_view s, json::error_code &)
+    {
+        return number(u, string_view(s.data(), s.size()));
+    }
+
+    bool on_double(double d, json::string_view s, json::error_code &)
+    {
+        return number(d, string_view(s.data(), s.size()));
+    }
+
+    bool on_bool(bool b, json::error_code &)
+    {
+        begin_value();
+        if (m_in_element)
+        {
+            m_echo += b ? "true" : "false";
+        }
+        scalar(std::nullopt);
+        return true;
+    }
+
+    bool on_null(json::error_code &)
+    {
+        begin_value();
+        if (m_in_element)
+        {
+            m_echo += "null";
+        }
+        scalar(std::nullopt);
+        return true;
+    }
+
+    // comments are not enabled in the parse options
+    bool on_comment_part(json::string_view, json::error_code &) { return true; }
+    bool on_comment(json::string_view, json::error_code &) { return true; }
+};
+
+} // namespace
+
+ParsedInput parse_rects(std::string_view json_text, size_t limit)
+{
+    json::basic_parser<RectsHandler> parser(json::parse_options{}, limit);
+    json::error_code ec;
+    size_t consumed = parser.write_some(false, json_text.data(), json_text.size(), ec);
+
+    ParsedInput &result = parser.handler().result;
+    bool trailing_garbage = std::any_of(json_text.begin() + std::min(consumed, json_text.size()), json_text.end(), [](char c)
+                                        { return c != ' ' && c != '\t' && c != '\n' && c != '\r'; });
+    if (ec || !parser.done() || trailing_garbage)
+    {
+        result.status = ParsedInput::Status::SyntaxError;
+    }
+    else if (!parser.handler().root_is_object())
+    {
+        result.status = ParsedInput::Status::NotAnObject;
+    }
+    else if (!parser.handler().rects_is_array())
+    {
+        result.status = ParsedInput::Status::MissingRects;
+    }
+    else if (!result.invalid_rects.empty())
+    {
+        result.status = ParsedInput::Status::InvalidRects;
+    }
+    return std::move(result);
+}
+
+CoordinateType narrowest_coordinates(const std::vector<Rectangle> &rects)
+{
+    uint64_t max_end = 0;
+    for (const Rectangle &rect : rects)
+    {
+        max_end = std::max({max_end, uint64_t{rect.m_x} + rect.m_w, uint64_t{rect.m_y} + rect.m_h});
+    }
+    if (max_end <= UINT16_MAX)
+    {
+        return CoordinateType::Uint16;
+    }
+    if (max_end <= UINT32_MAX)
+    {
+        return CoordinateType::Uint32;
+    }
+    return CoordinateType::Uint64;
+}
+
+namespace
+{
+
+// Reads a little-endian unsigned integer of sizeof(T) bytes, whatever the byte order of the host.
+// Compilers turn the loop into a single load where it is already native
+template <typename T>
+T load_little_endian(const char *bytes)
+{
+    T value = 0;
+    for (size_t i = sizeof(T); i > 0; i -= 1)
+    {
+        value = static_cast<T>(value << 8 | static_cast<unsigned char>(bytes[i - 1]));
+    }
+    return value;
+}
+
+void append_little_endian(std::string &out, uint64_t value, size_t width)
+{
+    for (size_t i = 0; i < width; i += 1)
+    {
+        out += static_cast<char>(value >> (8 * i) & 0xff);
+    }
+}
+
+// The first `count` records of a binary input, at sizeof(T) bytes per coordinate
+template <typename T>
+void read_records(string_view records, size_t count, BinaryInput &result)
+{
+    auto &rects = result.rects.emplace<std::vector<BasicRectangle<T>>>();
+    rects.reserve(count);
+    for (size_t i = 0; i < count; i += 1)
+    {
+        const char *record = records.data() + i * 4 * sizeof(T);
+        T x = load_little_endian<T>(record);
+        T y = load_little_endian<T>(record + sizeof(T));
+        T w = load_little_endian<T>(record + 2 * sizeof(T));
+        T h = load_little_endian<T>(record + 3 * sizeof(T));
+        // summed in uint64_t, where uint32_t coordinates can't wrap around
+        bool valid = w > 0 && h > 0 && std::max({x, y, w, h}) <= UINT32_MAX &&
+                     uint64_t{x} + w <= std::numeric_limits<T>::max() && uint64_t{y} + h <= std::numeric_limits<T>::max();
+        if (valid)
+        {
+            rects.push_back(BasicRectangle<T>({.x = x, .y = y, .w = w, .h = h}));
+        }
+        else
+        {
+            result.invalid_rects.push_back("{\"x\":" + std::to_string(x) + ",\"y\":" + std::to_string(y) +
+                                           ",\"w\":" + std::to_string(w) + ",\"h\":" + std::to_string(h) + "}");
+        }
+    }
+}
+
+} // namespace
+
+bool is_binary_input(std::string_view contents)
+{
+    return contents.starts_with(BINARY_MAGIC);
+}
+
+BinaryInput read_binary_rects(std::string_view contents, size_t limit)
+{
+    BinaryInput result;
+    if (contents.size() < BINARY_HEADER_SIZE || !is_binary_input(contents) || contents[4] != BINARY_VERSION || contents[6] != 0 || contents[7] != 0)
+    {
+        result.status = BinaryInput::Status::BadHeader;
+        return result;
+    }
+    size_t width = static_cast<unsigned char>(contents[5]);
+    if (width != 2 && width != 4 && width != 8)
+    {
+        result.status = BinaryInput::Status::BadHeader;
+        return result;
+    }
+    uint64_t count = load_little_endian<uint64_t>(contents.data() + 8);
+    string_view records = contents.substr(BINARY_HEADER_SIZE);
+    size_t record_size = 4 * width;
+    // divided rather than multiplied, a corrupt count can't overflow
+    if (records.size() % record_size != 0 || records.size() / record_size != count)
+    {
+        result.status = BinaryInput::Status::SizeMismatch;
+        return result;
+    }
+    result.rect_count = count;
+    size_t kept = std::min<uint64_t>(count, limit);
+    switch (width)
+    {
+    case 2: read_records<uint16_t>(records, kept, result); break;
+    case 4: read_records<uint32_t>(records, kept, result); break;
+    default: read_records<uint64_t>(records, kept, result); break;
+    }
+    if (!result.invalid_rects.empty())
+    {
+        result.status = BinaryInput::Status::InvalidRects;
+    }
+    return result;
+}
+
+std::string binary_rects_document(const std::vector<Rectangle> &rects)
+{
+    CoordinateType type = narrowest_coordinates(rects);
+    size_t width = type == CoordinateType::Uint16 ? 2 : type == CoordinateType::Uint32 ? 4 : 8;
+    std::string document;
+    document.reserve(BINARY_HEADER_SIZE + rects.size() * 4 * width);
+    document += BINARY_MAGIC;
+    document += static_cast<char>(BINARY_VERSION);
+    document += static_cast<char>(width);
+    document.append(2, '\0');
+    append_little_endian(document, rects.size(), 8);
+    for (const Rectangle &rect : rects)
+    {
+        for (uint32_t coordinate : {rect.m_x, rect.m_y, rect.m_w, rect.m_h})
+        {
+            append_little_endian(document, coordinate, width);
+        }
+    }
+    return document;
+}
+
+std::string json_rects_document(const std::vector<Rectangle> &rects)
+{
+    std::string document = "{\n\t\"rects\": [\n";
+    for (size_t i = 0; i < rects.size(); i += 1)
+    {
+        const Rectangle &rect = rects[i];
+        document += "\t\t{\"x\": " + std::to_string(rect.m_x) + ", \"y\": " + std::to_string(rect.m_y) +
+                    ", \"w\": " + std::to_string(rect.m_w) + ", \"h\": " + std::to_string(rect.m_h) + "}";
+        document += i + 1 < rects.size() ? ",\n" : "\n";
+    }
+    return document + "\t]\n}\n";
+}
+
+// Reads everything left in fd. Used for whatever can't be mapped
+static bool read_all(int fd, std::string &out)
+{
+    char chunk[1 << 16];
+    for (;;)
+    {
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n == 0)
+        {
+            return true;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        out.append(chunk, n);
+    }
+}
+
+std::optional<InputFile> InputFile::open(const std::string &path)
+{
+    InputFile file;
+    if (path == "-")
+    {
+        if (!read_all(STDIN_FILENO, file.m_buffer))
+        {
+            return std::nullopt;
+        }
+        return file;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return std::nullopt;
+    }
+
+    struct stat info;
+    bool mappable = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0;
+    if (mappable)
+    {
+        void *mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            // the parser reads front to back exactly once: read ahead aggressively, drop pages behind
+            ::madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+            file.m_mapping = mapping;
+            file.m_mapping_size = info.st_size;
+            ::close(fd);
+            return file;
+        }
+    }
+
+    bool ok = read_all(fd, file.m_buffer);
+    ::close(fd);
+    if (!ok)
+    {
+        return std::nullopt;
+    }
+    return file;
+}
+
+InputFile::InputFile(InputFile &&other) noexcept
+    : m_mapping(std::exchange(other.m_mapping, nullptr)),
+      m_mapping_size(std::exchange(other.m_mapping_size, 0)),
+      m_buffer(std::move(other.m_buffer))
+{
+}
+
+InputFile &InputFile::operator=(InputFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_mapping != nullptr)
+        {
+            ::munmap(m_mapping, m_mapping_size);
+        }
+        m_mapping = std::exchange(other.m_mapping, nullptr);
+        m_mapping_size = std::exchange(other.m_mapping_size, 0);
+        m_buffer = std::move(other.m_buffer);
+    }
+    return *this;
+}
+
+InputFile::~InputFile()
+{
+    if (m_mapping != nullptr)
+    {
+        ::munmap(m_mapping, m_mapping_size);
+    }
+}
+
+std::string_view InputFile::contents() const
+{
+    if (m_mapping != nullptr)
+    {
+        return std::string_view(static_cast<const char *>(m_mapping), m_mapping_size);
+    }
+    return m_buffer;
+}
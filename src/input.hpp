@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+#include "rectangle.hpp"
+
+/**
+ * Read-only contents of an input file.
+ * Regular files are memory-mapped, so the parser reads straight from the page cache without any copy.
+ * Anything that can't be mapped (stdin, pipes, ...) falls back to being read into a buffer.
+ */
+class InputFile
+{
+    // the mapping, or nullptr when the contents live in m_buffer
+    void *m_mapping = nullptr;
+    size_t m_mapping_size = 0;
+    std::string m_buffer;
+
+    InputFile() = default;
+
+public:
+    // "-" reads stdin. std::nullopt if the file can't be opened
+    static std::optional<InputFile> open(const std::string &path);
+
+    InputFile(InputFile &&other) noexcept;
+    InputFile &operator=(InputFile &&other) noexcept;
+    InputFile(const InputFile &) = delete;
+    InputFile &operator=(const InputFile &) = delete;
+    ~InputFile();
+
+    std::string_view contents() const;
+};
+
+// Outcome of reading the "rects" array of an input document
+struct ParsedInput
+{
+    enum class Status
+    {
+        Ok,
+        SyntaxError,
+        // the top level JSON value is not an object
+        NotAnObject,
+        // the top level object has no "rects" array
+        MissingRects,
+        // some elements of "rects" are not valid rectangles, see invalid_rects
+        InvalidRects,
+    };
+
+    Status status = Status::Ok;
+    // the first `limit` valid rectangles, in input order
+    std::vector<Rectangle> rects;
+    // number of elements in "rects", including the ones past the limit
+    size_t rect_count = 0;
+    // JSON text of every invalid element within the limit, in input order
+    std::vector<std::string> invalid_rects;
+};
+
+/**
+ * Reads the rectangles of an input document in a single streaming pass, without building a JSON DOM.
+ * Only the first `limit` elements of "rects" are turned into rectangles and validated, the rest are just counted.
+ * Validation follows Rectangle::create: exactly the fields x, y, w and h, each holding a uint32_t, and w and h of at least 1.
+ */
+ParsedInput parse_rects(std::string_view json, size_t limit);
+
+// Coordinate types the loader chooses from
+enum class CoordinateType
+{
+    Uint16,
+    Uint32,
+    Uint64,
+};
+
+/**
+ * The narrowest type that holds x + w and y + h of every rectangle, so no range end wraps around.
+ * Parsed coordinates are uint32_t, so their ends always fit in uint64_t.
+ * Narrower coordinates fit more boxes in each SIMD register and move less memory.
+ */
+CoordinateType narrowest_coordinates(const std::vector<Rectangle> &rects);
+
+/**
+ * The binary input format, for scenes whose JSON takes longer to parse than to answer.
+ *
+ * A 16 byte header, then one record per rectangle, all of it little-endian:
+ *   bytes 0-3   magic "NRCT"
+ *   byte  4     format version, BINARY_VERSION
+ *   byte  5     coordinate width in bytes: 2, 4 or 8
+ *   bytes 6-7   zero
+ *   bytes 8-15  number of rectangles
+ *   then x, y, w, h of each rectangle, `width` bytes each, packed
+ * Coordinates follow the same rules as JSON: they fit in uint32_t, w and h are at least 1.
+ * The width is the narrowest_coordinates of the rectangles, so x + w and y + h fit in it as well
+ * and the records are already in the coordinate type the engines run on.
+ */
+constexpr std::string_view BINARY_MAGIC = "NRCT";
+constexpr uint8_t BINARY_VERSION = 1;
+constexpr size_t BINARY_HEADER_SIZE = 16;
+
+// Whether contents are in the binary format rather than JSON, which can't start with an 'N'
+bool is_binary_input(std::string_view contents);
+
+// Outcome of reading a binary input document
+struct BinaryInput
+{
+    enum class Status
+    {
+        Ok,
+        // the header is cut short, or has an unknown version or width
+        BadHeader,
+        // the size of the records doesn't match the count of the header
+        SizeMismatch,
+        // some records are not valid rectangles, see invalid_rects
+        InvalidRects,
+    };
+
+    Status status = Status::Ok;
+    // the first `limit` valid rectangles in the coordinates of the file, at the index of their CoordinateType
+    std::variant<std::vector<BasicRectangle<uint16_t>>, std::vector<Rectangle>, std::vector<BasicRectangle<uint64_t>>> rects;
+    // number of records, including the ones past the limit
+    size_t rect_count = 0;
+    // every invalid record within the limit as a JSON object, in input order
+    std::vector<std::string> invalid_rects;
+};
+
+/**
+ * Reads the first `limit` records of a binary input document straight from its bytes, in a single pass:
+ * the only copy is each valid record going into its vector. The rest are only counted.
+ */
+BinaryInput read_binary_rects(std::string_view contents, size_t limit);
+
+// rects as a binary input document, in the narrowest coordinates that hold them
+std::string binary_rects_document(const std::vector<Rectangle> &rects);
+// rects as a JSON input document, one rectangle per line
+std::string json_rects_document(const std::vector<Rectangle> &rects);
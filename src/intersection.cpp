@@ -5,56 +5,665 @@
 #include <iostream>
 #include <cstdint>
 #include <deque>
+#include <queue>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <optional>
+#include <memory_resource>
+#include <limits>
 // #include "rectangle.hpp"
 #include "intersection.hpp"
+#include "canonical_search.hpp"
+#include "intersection_stream.hpp"
+#include "small_search.hpp"
+#include "stats.hpp"
 
 using std::vector, std::string;
 
-using Id = uintptr_t;
-
 // Constructor that accepts an r-value reference to a vector
-Intersection::Intersection(const Rectangle &shape, const std::set<Id> &ids)
+template <typename T>
+BasicIntersection<T>::BasicIntersection(const Shape &shape, const IdSet &ids)
     : intersection_shape(shape), intersecting_rectangles(ids) {}
 
+template <typename T>
+BasicIntersection<T>::BasicIntersection(const Shape &shape, IdSet &&ids)
+    : intersection_shape(shape), intersecting_rectangles(std::move(ids)) {}
+
+template <typename T>
+const BasicRectangle<T> &BasicIntersection<T>::shape() const
+{
+    return intersection_shape;
+}
+
+template <typename T>
+const IdSet &BasicIntersection<T>::ids() const
+{
+    return intersecting_rectangles;
+}
+
+// Reference broad phase: every i<j pair goes through BasicRectangle::intersect
+template <typename T>
+static std::vector<std::pair<Id, Id>> nested_loop_pairs(vector<BasicRectangle<T>> const &inputs)
+{
+    std::vector<std::pair<Id, Id>> pairs;
+    for (Id i = 1; i <= inputs.size(); i += 1)
+    {
+        for (Id j = i + 1; j <= inputs.size(); j += 1)
+        {
+            NITRO_COUNT(pairs_tested, 1);
+            // Ids are 1 based
+            if (inputs[i - 1].intersect(inputs[j - 1]).has_value())
+            {
+                pairs.emplace_back(i, j);
+            }
+        }
+    }
+    return pairs;
+}
+
+/**
+ * Active set of the sweep: a max tree over every rectangle, ordered by where its y range starts.
+ * A leaf holds the y end of its rectangle while it is active, and lowest() otherwise. Every node holds the largest
+ * y end below it, so a query only walks down into subtrees that hold an overlapping rectangle.
+ */
+template <typename T>
+class ActiveIntervals
+{
+    // y start of the rectangle at each leaf, ascending
+    std::vector<T> m_starts;
+    std::vector<T> m_max;
+
+    void set(size_t node, size_t lo, size_t hi, size_t leaf, T y_end)
+    {
+        if (hi - lo == 1)
+        {
+            m_max[node] = y_end;
+            return;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        if (leaf < mid)
+        {
+            set(2 * node, lo, mid, leaf, y_end);
+        }
+        else
+        {
+            set(2 * node + 1, mid, hi, leaf, y_end);
+        }
+        m_max[node] = std::max(m_max[2 * node], m_max[2 * node + 1]);
+    }
+
+    // Leaves of [lo, hi) before `until` whose y end is past y
+    template <typename Visit>
+    void query(size_t node, size_t lo, size_t hi, size_t until, T y, Visit &visit) const
+    {
+        if (until <= lo || !(m_max[node] > y))
+        {
+            return;
+        }
+        if (hi - lo == 1)
+        {
+            visit(lo);
+            return;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        query(2 * node, lo, mid, until, y, visit);
+        query(2 * node + 1, mid, hi, until, y, visit);
+    }
+
+public:
+    // starts must be sorted
+    explicit ActiveIntervals(std::vector<T> starts)
+        : m_starts(std::move(starts)), m_max(4 * m_starts.size() + 4, std::numeric_limits<T>::lowest()) {}
+
+    void insert(size_t leaf, T y_end)
+    {
+        set(1, 0, m_starts.size(), leaf, y_end);
+    }
+
+    void erase(size_t leaf)
+    {
+        set(1, 0, m_starts.size(), leaf, std::numeric_limits<T>::lowest());
+    }
+
+    // Calls visit(leaf) for every active rectangle whose y range overlaps [y, y_end)
+    template <typename Visit>
+    void overlapping(T y, T y_end, Visit visit) const
+    {
+        size_t until = std::lower_bound(m_starts.begin(), m_starts.end(), y_end) - m_starts.begin();
+        query(1, 0, m_starts.size(), until, y, visit);
+    }
+};
+
+/**
+ * Sort-and-sweep broad phase.
+ *
+ * Rectangles are visited by increasing m_x. The active set holds the rectangles whose x range
+ * is still open at the current x, see ActiveIntervals. Rectangles whose x range has closed are
+ * evicted through a min-heap on their x end.
+ * A newly visited rectangle only walks down the paths of the active entries its y range overlaps,
+ * so it costs O(log n) per pair found on top of O(log n) per rectangle: O((n + k) log n) rather than O(n^2),
+ * even when most of the active set lies wholly below or above it.
+ *
+ * The overlap test uses the exact same arithmetic as BasicRectangle::intersect, so both broad phases agree.
+ */
+template <typename T>
+static std::vector<std::pair<Id, Id>> sweep_pairs(vector<BasicRectangle<T>> const &inputs)
+{
+    using Expiry = std::pair<T, size_t>;
+
+    std::vector<Id> order(inputs.size());
+    std::iota(order.begin(), order.end(), Id{1});
+    // the leaves of the active set
+    std::vector<Id> by_y = order;
+    std::sort(order.begin(), order.end(), [&inputs](Id a, Id b)
+              { return inputs[a - 1].m_x < inputs[b - 1].m_x; });
+    std::sort(by_y.begin(), by_y.end(), [&inputs](Id a, Id b)
+              { return inputs[a - 1].m_y < inputs[b - 1].m_y; });
+    std::vector<size_t> leaf_of(inputs.size() + 1);
+    std::vector<T> starts(by_y.size());
+    for (size_t leaf = 0; leaf < by_y.size(); leaf += 1)
+    {
+        leaf_of[by_y[leaf]] = leaf;
+        starts[leaf] = inputs[by_y[leaf] - 1].m_y;
+    }
+
+    ActiveIntervals<T> active(std::move(starts));
+    std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry>> expiry;
+    std::vector<std::pair<Id, Id>> pairs;
+    for (Id id : order)
+    {
+        const BasicRectangle<T> &rect = inputs[id - 1];
+        T x_end = rect.x_end();
+        T y_end = rect.y_end();
+        // Coordinates that wrap around T never intersect anything (see BasicRectangle::intersect)
+        if (x_end <= rect.m_x || y_end <= rect.m_y)
+        {
+            continue;
+        }
+
+        while (!expiry.empty() && expiry.top().first <= rect.m_x)
+        {
+            active.erase(expiry.top().second);
+            expiry.pop();
+        }
+
+        // everything left in the active set overlaps rect on the x-axis
+        active.overlapping(rect.m_y, y_end, [&](size_t leaf)
+                           {
+            NITRO_COUNT(pairs_tested, 1);
+            Id other = by_y[leaf];
+            pairs.emplace_back(std::min(id, other), std::max(id, other)); });
+
+        active.insert(leaf_of[id], y_end);
+        expiry.emplace(x_end, leaf_of[id]);
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+template <typename T>
+std::vector<std::pair<Id, Id>> BasicIntersection<T>::overlapping_pairs(vector<Shape> const &inputs, BroadPhase broad_phase)
+{
+    auto pairs = broad_phase == BroadPhase::NestedLoop ? nested_loop_pairs(inputs) : sweep_pairs(inputs);
+    NITRO_COUNT(pair_hits, pairs.size());
+    return pairs;
+}
+
+// Zobrist keys: one random 64 bit key per id, the hash of an id set is the XOR of the keys of its ids.
+// Extending a set with one id only costs one XOR
+static std::vector<uint64_t> zobrist_keys(size_t count)
+{
+    // splitmix64 with a fixed seed, so runs are reproducible
+    std::vector<uint64_t> keys(count + 1);
+    uint64_t state = 0x9E3779B97F4A7C15;
+    for (auto &key : keys)
+    {
+        state += 0x9E3779B97F4A7C15;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        key = z ^ (z >> 31);
+    }
+    return keys;
+}
+
+// Id sets found so far, keyed on their Zobrist hash.
+// The ids themselves are only compared when two sets land on the same hash
+class SeenIdSets
+{
+    std::pmr::unordered_multimap<uint64_t, const IdSet *> m_sets;
+
+public:
+    explicit SeenIdSets(std::pmr::memory_resource *memory) : m_sets(memory) {}
+
+    bool contains(uint64_t hash, const IdSet &ids) const
+    {
+        auto [begin, end] = m_sets.equal_range(hash);
+        return std::any_of(begin, end, [&ids](const auto &entry)
+                           { return *entry.second == ids; });
+    }
+
+    // ids must outlive this object
+    void insert(uint64_t hash, const IdSet &ids)
+    {
+        m_sets.emplace(hash, &ids);
+    }
+};
+
+/**
+ * Working storage of one engine call: options.memory, or else an arena of its own.
+ * The arena hands out slices of a few large blocks and frees them all at once when the call returns,
+ * so the many short lived id sets of a search cost next to nothing to allocate and nothing to free.
+ * Results are copied out of it before they are returned.
+ */
+class CallMemory
+{
+    std::optional<std::pmr::monotonic_buffer_resource> m_arena;
+    std::pmr::memory_resource *m_memory;
+
+public:
+    explicit CallMemory(const IntersectionOptions &options) : m_memory(options.memory)
+    {
+        if (m_memory == nullptr)
+        {
+            m_memory = &m_arena.emplace();
+        }
+    }
+
+    CallMemory(const CallMemory &) = delete;
+    CallMemory &operator=(const CallMemory &) = delete;
+
+    std::pmr::memory_resource *get() const
+    {
+        return m_memory;
+    }
+};
+
 /**
  * This function will calculate all the intersections between the Rectangles given as input,
  * as well as intersections between those intersections and the remaining rectangles.
  * 
  * Algorithm:
- * 1. Compute 1st degree intersections 
+ * 1. Compute 1st degree intersections (see overlapping_pairs)
  * 2. For each such intersection, push to a queue intersections with other rectangles that are not already involved in said intersection
+ *    (with Enumeration::Canonical, only rectangles with a greater id than any already involved)
  * 3. Keep popping from the q until there are no intersections left
  * 
+ * Canonical walks of at most 64 rectangles on a single thread go to get_intersections<N>, which skips the pair list,
+ * unless options.small_search is off.
 */
-std::set<Intersection> Intersection::get_intersections(vector<Rectangle> const &inputs)
+template <typename T>
+std::set<BasicIntersection<T>> BasicIntersection<T>::get_intersections(vector<Shape> const &inputs, const IntersectionOptions &options)
 {
+    unsigned threads = options.threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : options.threads;
+    if (options.enumeration == Enumeration::Canonical && options.small_search && threads == 1 && inputs.size() <= SMALL_SEARCH_MAX_INPUTS)
+    {
+        if (inputs.size() <= 16)
+        {
+            return get_intersections<16>(inputs, options);
+        }
+        return inputs.size() <= 32 ? get_intersections<32>(inputs, options) : get_intersections<64>(inputs, options);
+    }
+    auto pairs = overlapping_pairs(inputs, options.broad_phase);
+    if (options.enumeration == Enumeration::Exhaustive)
+    {
+        return exhaustive_extension(inputs, pairs, options);
+    }
+    if (threads > 1 && pairs.size() > 1)
+    {
+        return parallel_canonical_extension(inputs, pairs, options, threads);
+    }
+    return canonical_extension(inputs, pairs, options);
+}
 
-	// Compute 1st degree intersections
-    // A solution that only requires a single loop is possible
-    // but would require considering single-rectangle intersections. This approach feels more understandable_
-    // perhaps an intersection of a single rectangle
-    std::deque<Intersection> q;
-    for (Id i = 1; i <= inputs.size(); i += 1)
+/**
+ * Depth first walk of the canonical enumeration, see IntersectionStream.
+ * The stream yields id sets in the order of std::set<Intersection>, so every insertion goes straight to the end of the result.
+*/
+template <typename T>
+std::set<BasicIntersection<T>> BasicIntersection<T>::canonical_extension(vector<Shape> const &inputs, const std::vector<std::pair<Id, Id>> &pairs, const IntersectionOptions &options)
+{
+    std::set<BasicIntersection> all_intersections;
+    BasicIntersectionStream<T> stream(inputs, pairs, options);
+    for (auto inter = stream.next(); inter.has_value(); inter = stream.next())
     {
-        for (Id j = i + 1; j <= inputs.size(); j += 1)
+        all_intersections.insert(all_intersections.end(), std::move(*inter));
+    }
+    return all_intersections;
+}
+
+/**
+ * Branch and bound top-k over the canonical enumeration.
+ *
+ * best is a heap with the worst of the k best intersections so far on top. Extending an intersection can only shrink it,
+ * so once k have been found, a branch whose shape is no larger than the worst of them can't improve on it and is cut whole.
+ * Equal areas don't need to be explored either: the walk goes in std::set<Intersection> order, so everything found later
+ * comes after the current worst in that order and loses the tie.
+ */
+template <typename T>
+std::vector<BasicIntersection<T>> BasicIntersection<T>::get_largest_intersections(vector<Shape> const &inputs, size_t k, const IntersectionOptions &options)
+{
+    if (k == 0)
+    {
+        return {};
+    }
+    auto pairs = overlapping_pairs(inputs, options.broad_phase);
+    CanonicalSearch<T> search(inputs, pairs, options);
+    CallMemory memory(options);
+    typename CanonicalSearch<T>::Scratch scratch(memory.get());
+    auto ranks_before = [](const BasicIntersection &lhs, const BasicIntersection &rhs)
+    {
+        auto lhs_area = lhs.intersection_shape.area();
+        auto rhs_area = rhs.intersection_shape.area();
+        return lhs_area > rhs_area || (lhs_area == rhs_area && lhs < rhs);
+    };
+    std::pmr::vector<BasicIntersection> best(memory.get());
+    std::pmr::vector<BasicIntersection> stack(memory.get());
+    for (auto [i, j] : pairs)
+    {
+        stack.push_back(search.seed(i, j, memory.get()));
+        while (!stack.empty())
         {
-            // Ids are 1 based
-            auto inter = inputs[i - 1].intersect(inputs[j - 1]);
-            if (inter.has_value())
+            BasicIntersection inter = std::move(stack.back());
+            stack.pop_back();
+            if (best.size() == k && inter.intersection_shape.area() <= best.front().intersection_shape.area())
+            {
+                continue;
+            }
+            search.extend(inter, scratch, [&stack](BasicIntersection &&extension)
+                          { stack.push_back(std::move(extension)); });
+            NITRO_HIGH_WATER(queue_high_water, stack.size());
+            if (search.within_degree_bounds(inter))
+            {
+                best.push_back(std::move(inter));
+                std::push_heap(best.begin(), best.end(), ranks_before);
+                if (best.size() > k)
+                {
+                    std::pop_heap(best.begin(), best.end(), ranks_before);
+                    best.pop_back();
+                }
+            }
+        }
+    }
+    std::sort_heap(best.begin(), best.end(), ranks_before);
+    NITRO_COUNT(intersections_emitted, best.size());
+    // copies, the ids of best live in memory
+    return std::vector<BasicIntersection>(best.begin(), best.end());
+}
+
+// Tomita pivoting step of Bron–Kerbosch: reports every maximal clique that contains clique, extended from candidates but not from excluded
+template <typename T>
+static void bron_kerbosch(const vector<BasicRectangle<T>> &inputs, const vector<IdSet> &neighbours, IdSet &clique, const BasicRectangle<T> &shape,
+                          IdSet candidates, IdSet excluded, std::set<BasicIntersection<T>> &maximal)
+{
+    if (candidates.empty())
+    {
+        // single rectangles are not intersections
+        if (excluded.empty() && clique.size() >= 2)
+        {
+            maximal.insert(BasicIntersection<T>(shape, clique));
+        }
+        return;
+    }
+    // Every maximal clique contains the pivot or one of its non neighbours, so only those have to be branched on.
+    // The pivot with the most neighbours among the candidates leaves the fewest branches
+    Id pivot = 0;
+    size_t pivot_degree = 0;
+    for (const IdSet *pool : {&candidates, &excluded})
+    {
+        for (Id u : *pool)
+        {
+            size_t degree = candidates.common_size(neighbours[u]);
+            if (pivot == 0 || degree > pivot_degree)
             {
-                q.push_back(Intersection(*inter, {i, j}));
+                pivot = u;
+                pivot_degree = degree;
             }
         }
     }
+    for (Id v : candidates - neighbours[pivot])
+    {
+        // Helly property: v overlaps every rectangle of the clique, so it overlaps their common region too
+        clique.insert(v);
+        bron_kerbosch(inputs, neighbours, clique, *shape.intersect(inputs[v - 1]),
+                      candidates & neighbours[v], excluded & neighbours[v], maximal);
+        clique.erase(v);
+        candidates.erase(v);
+        excluded.insert(v);
+    }
+}
+
+/**
+ * Intersections that no other intersection contains, found as maximal cliques of the overlap graph.
+ *
+ * Rectangles have the Helly property: if they overlap pairwise, they share a common region
+ * (on each axis every range starts before every other one ends, so the latest start is before the earliest end).
+ * Intersections are therefore exactly the cliques of the overlap graph, and maximal intersections its maximal cliques.
+ * A group of k rectangles over the same spot is one maximal intersection rather than 2^k - k - 1 intersections.
+ *
+ * The outer level branches on every id with its greater neighbours as candidates and its smaller ones as excluded,
+ * so each maximal clique is reported from its smallest id only.
+ */
+template <typename T>
+std::set<BasicIntersection<T>> BasicIntersection<T>::get_maximal_intersections(vector<Shape> const &inputs, BroadPhase broad_phase)
+{
+    auto pairs = overlapping_pairs(inputs, broad_phase);
+    // Ids are 1 based, neighbours[0] stays empty
+    vector<IdSet> later(inputs.size() + 1);
+    vector<IdSet> earlier(inputs.size() + 1);
+    vector<IdSet> neighbours(inputs.size() + 1);
+    for (auto [i, j] : pairs)
+    {
+        later[i].insert(j);
+        earlier[j].insert(i);
+        neighbours[i].insert(j);
+        neighbours[j].insert(i);
+    }
+
+    std::set<BasicIntersection> maximal;
+    IdSet clique;
+    for (Id v = 1; v <= inputs.size(); v += 1)
+    {
+        if (later[v].empty())
+        {
+            // every clique through v has a smaller id, it was reported there already
+            continue;
+        }
+        clique.insert(v);
+        bron_kerbosch(inputs, neighbours, clique, inputs[v - 1], later[v], earlier[v], maximal);
+        clique.erase(v);
+    }
+    NITRO_COUNT(intersections_emitted, maximal.size());
+    return maximal;
+}
+
+/**
+ * Pending intersections of one worker of parallel_canonical_extension.
+ * The owner works depth first from the back, thieves take from the front, where the oldest and usually largest subtrees are.
+ */
+template <typename T>
+class WorkDeque
+{
+    std::mutex m_mutex;
+    std::deque<BasicIntersection<T>> m_items;
+
+public:
+    void push(BasicIntersection<T> &&inter)
+    {
+        std::lock_guard lock(m_mutex);
+        m_items.push_back(std::move(inter));
+        NITRO_HIGH_WATER(queue_high_water, m_items.size());
+    }
+
+    std::optional<BasicIntersection<T>> pop()
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_items.empty())
+        {
+            return std::nullopt;
+        }
+        BasicIntersection<T> inter = std::move(m_items.back());
+        m_items.pop_back();
+        return inter;
+    }
+
+    std::optional<BasicIntersection<T>> steal()
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_items.empty())
+        {
+            return std::nullopt;
+        }
+        BasicIntersection<T> inter = std::move(m_items.front());
+        m_items.pop_front();
+        return inter;
+    }
+};
+
+/**
+ * The canonical enumeration spread over several threads.
+ *
+ * Subtrees of the enumeration are independent, so any intersection can be extended by any thread.
+ * Seed pairs are dealt round robin to per-thread deques, and a thread whose deque runs dry steals from the others.
+ * `pending` counts the intersections that are queued or being extended. Extensions are counted before their parent is
+ * done, so it only drops to 0 once the whole enumeration is over.
+ * Each thread collects its results on its own, they are only sorted into a std::set once every thread is done.
+ * Without options.memory, each thread allocates the extensions it makes from an arena of its own, so threads never share one.
+ */
+template <typename T>
+std::set<BasicIntersection<T>> BasicIntersection<T>::parallel_canonical_extension(vector<Shape> const &inputs, const std::vector<std::pair<Id, Id>> &pairs, const IntersectionOptions &options, unsigned threads)
+{
+    threads = static_cast<unsigned>(std::min<size_t>(threads, pairs.size()));
+    CanonicalSearch<T> search(inputs, pairs, options);
+    std::vector<WorkDeque<T>> deques(threads);
+    std::vector<std::vector<BasicIntersection>> results(threads);
+    // a std::deque, as a growing std::vector would have to move them
+    std::deque<CallMemory> memory;
+    for (unsigned me = 0; me < threads; me += 1)
+    {
+        memory.emplace_back(options);
+    }
+    std::atomic<size_t> pending = pairs.size();
+    for (size_t k = 0; k < pairs.size(); k += 1)
+    {
+        deques[k % threads].push(search.seed(pairs[k].first, pairs[k].second, memory[k % threads].get()));
+    }
+
+    auto worker = [&](unsigned me)
+    {
+        typename CanonicalSearch<T>::Scratch scratch(memory[me].get());
+        while (true)
+        {
+            std::optional<BasicIntersection> inter = deques[me].pop();
+            for (unsigned k = 1; k < threads && !inter.has_value(); k += 1)
+            {
+                inter = deques[(me + k) % threads].steal();
+            }
+            if (!inter.has_value())
+            {
+                if (pending.load() == 0)
+                {
+                    return;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            search.extend(*inter, scratch, [&](BasicIntersection &&extension)
+                          {
+                              pending.fetch_add(1);
+                              deques[me].push(std::move(extension)); });
+            if (search.within_degree_bounds(*inter))
+            {
+                results[me].push_back(std::move(*inter));
+                NITRO_COUNT(intersections_emitted, 1);
+            }
+            pending.fetch_sub(1);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned me = 1; me < threads; me += 1)
+    {
+        workers.emplace_back(worker, me);
+    }
+    worker(0);
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+
+    std::vector<BasicIntersection> merged = std::move(results[0]);
+    for (unsigned me = 1; me < threads; me += 1)
+    {
+        std::move(results[me].begin(), results[me].end(), std::back_inserter(merged));
+    }
+    std::sort(merged.begin(), merged.end());
+    // sorted input: every insertion goes to the end.
+    // Inserted as copies, a move would keep the ids in the memory of the threads
+    std::set<BasicIntersection> all_intersections;
+    for (const auto &inter : merged)
+    {
+        all_intersections.insert(all_intersections.end(), inter);
+    }
+    return all_intersections;
+}
+
+// Grows every intersection with every id it doesn't contain yet, throwing away the id sets that were already found
+template <typename T>
+std::set<BasicIntersection<T>> BasicIntersection<T>::exhaustive_extension(vector<Shape> const &inputs, const std::vector<std::pair<Id, Id>> &pairs, const IntersectionOptions &options)
+{
+    Dedup dedup = options.dedup;
+    std::vector<uint64_t> keys = zobrist_keys(inputs.size());
+    CallMemory memory(options);
+
+	// Compute 1st degree intersections
+    // A solution that only requires a single loop is possible
+    // but would require considering single-rectangle intersections. This approach feels more understandable_
+    // perhaps an intersection of a single rectangle
+    // Every queued intersection carries the Zobrist hash of its ids
+    // The queue, its id sets and the dedup index live in memory, all_intersections holds copies of them
+    std::pmr::deque<std::pair<BasicIntersection, uint64_t>> q(memory.get());
+    for (auto [i, j] : pairs)
+    {
+        // Ids are 1 based
+        q.emplace_back(BasicIntersection(*inputs[i - 1].intersect(inputs[j - 1]), IdSet({i, j}, memory.get())), keys[i] ^ keys[j]);
+    }
 
 	// Consider a solution using only 1 collection rather than 2 (q and all_intersections)
     // It's more performant, but would be more complex
-    std::set<Intersection> all_intersections(q.begin(), q.end());
+    std::set<BasicIntersection> all_intersections;
+    SeenIdSets seen(memory.get());
+    for (auto const &[inter, hash] : q)
+    {
+        auto it = all_intersections.insert(inter).first;
+        seen.insert(hash, it->intersecting_rectangles);
+    }
+
+    // if no other intersections between the same rectangles have been found so far
+    // covers the test case "two_single_overlaps_and_one_triple"
+    auto already_found = [&](uint64_t hash, const IdSet &ids)
+    {
+        if (dedup == Dedup::LinearScan)
+        {
+            return std::any_of(all_intersections.cbegin(), all_intersections.cend(), [&ids](const BasicIntersection &i)
+                               { return i.intersecting_rectangles == ids; });
+        }
+        return seen.contains(hash, ids);
+    };
+
     while (!q.empty())
     {
         // pop from queue
-        Intersection inter = q.front();
+        auto [inter, hash] = std::move(q.front());
         q.pop_front();
+        if (inter.intersecting_rectangles.size() >= options.max_degree)
+        {
+            continue;
+        }
 
         // for each of the rectangles in input
         for (Id id = 1; id <=inputs.size(); id += 1)
@@ -63,86 +672,85 @@ std::set<Intersection> Intersection::get_intersections(vector<Rectangle> const &
 			// Ids are 1-based
             auto rect = inputs[id - 1];
             // if the intersection doesn't already include the current rectangle
-            if (inter.intersecting_rectangles.find(id) == inter.intersecting_rectangles.end())
+            if (!inter.intersecting_rectangles.contains(id))
             {
+                NITRO_COUNT(extension_attempts, 1);
                 auto new_inter_shape = inter.intersection_shape.intersect(rect);
                 // if there is an intersection between the intersection and the current rectangle
                 if (new_inter_shape.has_value())
                 {
-                    std::set<Id> new_ids(inter.intersecting_rectangles);
+                    IdSet new_ids(inter.intersecting_rectangles, memory.get());
                     new_ids.insert(id);
-                    // if no other intersections between the same rectangles have been found so far
-                    // covers the test case "two_single_overlaps_and_one_triple"
-                    if (!std::any_of(all_intersections.cbegin(), all_intersections.cend(), [&new_ids](const Intersection &i)
-                                     { return i.intersecting_rectangles == new_ids; }))
+                    uint64_t new_hash = hash ^ keys[id];
+                    if (already_found(new_hash, new_ids))
                     {
-                        auto new_inter = Intersection(*new_inter_shape, new_ids);
-                        q.push_back(new_inter);
-                        all_intersections.insert(new_inter);
+                        NITRO_COUNT(dedup_hits, 1);
+                    }
+                    else
+                    {
+                        NITRO_COUNT(dedup_misses, 1);
+                        auto new_inter = BasicIntersection(*new_inter_shape, std::move(new_ids));
+                        auto it = all_intersections.insert(new_inter).first;
+                        seen.insert(new_hash, it->intersecting_rectangles);
+                        q.emplace_back(std::move(new_inter), new_hash);
+                        NITRO_HIGH_WATER(queue_high_water, q.size());
                     }
                 }
             }
         }
     }
+    std::erase_if(all_intersections, [&options](const BasicIntersection &inter)
+                  {
+                      size_t degree = inter.intersecting_rectangles.size();
+                      return degree < options.min_degree || degree > options.max_degree; });
+    NITRO_COUNT(intersections_emitted, all_intersections.size());
     return all_intersections;
 }
 
 // comparing intersecting ids would be sufficient, since no 2 intersections can have the same 2 ids
 // however, this extra check might prevent some bugs
-bool operator==(const Intersection &lhs, const Intersection &rhs)
+template <typename T>
+bool operator==(const BasicIntersection<T> &lhs, const BasicIntersection<T> &rhs)
 {
-    return lhs.intersecting_rectangles == rhs.intersecting_rectangles && lhs.intersection_shape == rhs.intersection_shape;
+    return lhs.ids() == rhs.ids() && lhs.shape() == rhs.shape();
 }
 
 // ordering is necessary for consistent test case results
-bool operator<(const Intersection &lhs, const Intersection &rhs)
+template <typename T>
+bool operator<(const BasicIntersection<T> &lhs, const BasicIntersection<T> &rhs)
 {
-    return lhs.intersecting_rectangles < rhs.intersecting_rectangles;
+    return lhs.ids() < rhs.ids();
 }
 
-std::ostream &operator<<(std::ostream &os, const Intersection &inter)
+template <typename T>
+std::ostream &operator<<(std::ostream &os, const BasicIntersection<T> &inter)
 {
-    os << "Intersection Shape: " << inter.intersection_shape << ", IDs: ";
-    for (const auto &id : inter.intersecting_rectangles)
+    os << "Intersection Shape: " << inter.shape() << ", IDs: ";
+    for (const auto &id : inter.ids())
     {
         os << id << " ";
     }
     return os;
 }
 
-std::ostream &operator<<(std::ostream &os, const std::set<Intersection> &s)
+template <typename T>
+std::ostream &operator<<(std::ostream &os, const std::set<BasicIntersection<T>> &s)
 {
     for (auto const &inter : s)
     {
-        os << "\t" << "Between rectangle " << inter.intersecting_rectangles << " at " << inter.intersection_shape << std::endl;
+        os << "\t" << "Between rectangle " << inter.ids() << " at " << inter.shape() << "\n";
     }
     os << "]";
     return os;
 }
 
-std::ostream &operator<<(std::ostream &os, const std::set<Id> &s)
-{
-    if (s.size() < 2)
-    {
-        os << "{}";
-    }
-    else
-    {
-        for (auto it = s.begin(); it != s.end(); ++it)
-        {
-            if (it == s.begin()) {
-                os << *it;
-            } else if (std::next(it) == s.end())
-            {
-                os << " and " << *it;
-            } else
-            {
-                os << ", " << *it;
-            }
-        }
-    }
-    return os;
-}
+#define NITRO_INSTANTIATE_INTERSECTION(T)                                                          \
+    template class BasicIntersection<T>;                                                          \
+    template bool operator==(const BasicIntersection<T> &lhs, const BasicIntersection<T> &rhs);   \
+    template bool operator<(const BasicIntersection<T> &lhs, const BasicIntersection<T> &rhs);    \
+    template std::ostream &operator<<(std::ostream &os, const BasicIntersection<T> &inter);       \
+    template std::ostream &operator<<(std::ostream &os, const std::set<BasicIntersection<T>> &s);
+NITRO_COORDINATE_TYPES(NITRO_INSTANTIATE_INTERSECTION)
 
 /* ============================================================== */
 /*                             TESTS                              */
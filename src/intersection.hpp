@@ -4,32 +4,113 @@
 #include <vector>
 #include <iostream>
 #include <cstdint>
+#include <memory_resource>
 #include "rectangle.hpp" 
+#include "id_set.hpp"
+#include "rectangle_soa.hpp"
 
-using Id = uintptr_t; 
+// Strategy used to find the 1st degree intersections (pairs of overlapping rectangles)
+enum class BroadPhase
+{
+    // Sort by x and sweep, only testing rectangles that are active on both axes at the same time
+    Sweep,
+    // Test every i<j pair. Quadratic, kept as the reference for differential tests
+    NestedLoop,
+};
+
+// How get_intersections grows intersections into higher degree ones
+enum class Enumeration
+{
+    // Only extend an intersection with ids greater than its largest id, so each id set is generated exactly once
+    Canonical,
+    // Try every id not in the intersection yet. Every id set is reached once per order of its ids, so repeats need a Dedup
+    Exhaustive,
+};
+
+// How the Exhaustive enumeration detects id sets it has already found
+enum class Dedup
+{
+    // Zobrist hash of the id set, ids are only compared on hash collisions
+    Hashed,
+    // Scan every intersection found so far. Quadratic in output size, kept as a reference
+    LinearScan,
+};
+
+struct IntersectionOptions
+{
+    BroadPhase broad_phase = BroadPhase::Sweep;
+    Enumeration enumeration = Enumeration::Canonical;
+    Dedup dedup = Dedup::Hashed;
+    // Instruction set of the batch intersect kernel used by the Canonical enumeration
+    Isa isa = best_isa();
+    // Single threaded Canonical walks of at most 64 rectangles go through a SmallSearch. Off, they take the generic path,
+    // kept to compare against
+    bool small_search = true;
+    // Worker threads of the Canonical enumeration, 0 for one per hardware thread
+    unsigned threads = 1;
+    // Only intersections of min_degree up to max_degree rectangles are reported.
+    // Nothing is extended past max_degree, so a low one cuts most of the search
+    size_t min_degree = 2;
+    size_t max_degree = SIZE_MAX;
+    // Working storage of the engines: pending intersections and their id sets. The results never live there.
+    // nullptr gives every call its own arena, released in one go when it returns.
+    // Several threads allocate from it at once when threads != 1, so it must be thread safe then
+    std::pmr::memory_resource *memory = nullptr;
+};
 
-class Intersection
+/**
+ * A set of rectangles with coordinates of type T, and the region they all overlap.
+ * Every engine works on any coordinate type, see NITRO_COORDINATE_TYPES.
+ */
+template <typename T>
+class BasicIntersection
 {
-    Rectangle intersection_shape;
-    std::set<Id> intersecting_rectangles;
+public:
+    using Shape = BasicRectangle<T>;
+
+private:
+    Shape intersection_shape;
+    IdSet intersecting_rectangles;
+
+    static std::set<BasicIntersection> canonical_extension(const std::vector<Shape> &inputs, const std::vector<std::pair<Id, Id>> &pairs, const IntersectionOptions &options);
+    static std::set<BasicIntersection> parallel_canonical_extension(const std::vector<Shape> &inputs, const std::vector<std::pair<Id, Id>> &pairs, const IntersectionOptions &options, unsigned threads);
+    static std::set<BasicIntersection> exhaustive_extension(const std::vector<Shape> &inputs, const std::vector<std::pair<Id, Id>> &pairs, const IntersectionOptions &options);
 
 public:
     // Constructor
-    Intersection(const Rectangle &shape, const std::set<Id> &ids);
+    BasicIntersection(const Shape &shape, const IdSet &ids);
+    // Keeps ids in the memory resource it was allocated from
+    BasicIntersection(const Shape &shape, IdSet &&ids);
+
+    const Shape &shape() const;
+    const IdSet &ids() const;
 
     // Function to compute intersections
-    static std::set<Intersection> get_intersections(const std::vector<Rectangle> &inputs);
+    static std::set<BasicIntersection> get_intersections(const std::vector<Shape> &inputs, const IntersectionOptions &options = {});
+    // Same as above for at most N <= 64 inputs, walked by a SmallSearch<T, N> whatever the enumeration and threads of options.
+    // get_intersections dispatches there by itself. N is one of NITRO_SMALL_SEARCH_SIZES, defined in small_search.hpp
+    template <size_t N>
+    static std::set<BasicIntersection> get_intersections(const std::vector<Shape> &inputs, const IntersectionOptions &options = {});
+
+    // The k intersections with the largest area, largest first. Equal areas are ordered like std::set<BasicIntersection>.
+    // Only the Canonical enumeration is used, on a single thread
+    static std::vector<BasicIntersection> get_largest_intersections(const std::vector<Shape> &inputs, size_t k, const IntersectionOptions &options = {});
 
-    // Friend declarations for operator overloads
-    friend bool operator==(const Intersection &lhs, const Intersection &rhs);
-    friend std::ostream &operator<<(std::ostream &os, const Intersection &inter);
-    friend bool operator<(const Intersection &lhs, const Intersection &rhs);
-    friend std::ostream &operator<<(std::ostream &os, const std::set<Intersection> &s);
+    // Only the intersections that are not part of a larger one
+    static std::set<BasicIntersection> get_maximal_intersections(const std::vector<Shape> &inputs, BroadPhase broad_phase = BroadPhase::Sweep);
+
+    // All pairs of overlapping rectangles, as (i, j) with 1-based ids and i < j, sorted
+    static std::vector<std::pair<Id, Id>> overlapping_pairs(const std::vector<Shape> &inputs, BroadPhase broad_phase = BroadPhase::Sweep);
 };
 
+using Intersection = BasicIntersection<uint32_t>;
+
 // Operator overloads that might interact with other objects
-bool operator==(const Intersection &lhs, const Intersection &rhs);
-bool operator<(const Intersection &lhs, const Intersection &rhs);
-std::ostream &operator<<(std::ostream &os, const Intersection &inter);
-std::ostream &operator<<(std::ostream &os, const std::set<Intersection> &s);
-std::ostream &operator<<(std::ostream &os, const std::set<Id> &s);
\ No newline at end of file
+template <typename T>
+bool operator==(const BasicIntersection<T> &lhs, const BasicIntersection<T> &rhs);
+template <typename T>
+bool operator<(const BasicIntersection<T> &lhs, const BasicIntersection<T> &rhs);
+template <typename T>
+std::ostream &operator<<(std::ostream &os, const BasicIntersection<T> &inter);
+template <typename T>
+std::ostream &operator<<(std::ostream &os, const std::set<BasicIntersection<T>> &s);
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include "intersection_index.hpp"
+
+IntersectionIndex::IntersectionIndex(std::vector<Rectangle> rects, const IntersectionOptions &options)
+    : m_rects(std::move(rects)), m_alive(m_rects.size(), true), m_min_degree(options.min_degree), m_max_degree(options.max_degree),
+      m_intersections(Intersection::get_intersections(m_rects, options))
+{
+    std::vector<Id> ids(m_rects.size());
+    std::iota(ids.begin(), ids.end(), Id{1});
+    if (!ids.empty())
+    {
+        m_trees.push_back(make_tree(std::move(ids)));
+    }
+}
+
+IntersectionIndex::Tree IntersectionIndex::make_tree(std::vector<Id> ids) const
+{
+    std::vector<Rectangle> rects;
+    rects.reserve(ids.size());
+    for (Id id : ids)
+    {
+        rects.push_back(m_rects[id - 1]);
+    }
+    return Tree{.tree = RTree(rects), .ids = std::move(ids)};
+}
+
+void IntersectionIndex::rebuild_if_stale()
+{
+    size_t indexed = 0;
+    for (const Tree &tree : m_trees)
+    {
+        indexed += tree.ids.size();
+    }
+    if (m_tree_removed >= std::max(MIN_REBUILD, indexed / 4))
+    {
+        std::vector<Id> live;
+        for (Id id = 1; id <= m_rects.size(); id += 1)
+        {
+            if (m_alive[id - 1])
+            {
+                live.push_back(id);
+            }
+        }
+        m_trees.clear();
+        if (!live.empty())
+        {
+            m_trees.push_back(make_tree(std::move(live)));
+        }
+        m_tree_removed = 0;
+        m_added.clear();
+        return;
+    }
+    if (m_added.size() < MIN_REBUILD)
+    {
+        return;
+    }
+    std::vector<Id> ids;
+    for (Id id : std::exchange(m_added, {}))
+    {
+        if (m_alive[id - 1])
+        {
+            ids.push_back(id);
+        }
+    }
+    // the carry of the binary counter, removed rectangles are left out along the way
+    while (!m_trees.empty() && m_trees.back().ids.size() < 2 * ids.size())
+    {
+        std::vector<Id> merged;
+        for (Id id : m_trees.back().ids)
+        {
+            if (m_alive[id - 1])
+            {
+                merged.push_back(id);
+            }
+            else
+            {
+                m_tree_removed -= 1;
+            }
+        }
+        merged.insert(merged.end(), ids.begin(), ids.end());
+        ids = std::move(merged);
+        m_trees.pop_back();
+    }
+    if (!ids.empty())
+    {
+        m_trees.push_back(make_tree(std::move(ids)));
+    }
+}
+
+std::vector<Id> IntersectionIndex::live_neighbours(Id id) const
+{
+    const Rectangle &rect = m_rects[id - 1];
+    std::vector<Id> neighbours;
+    for (const Tree &tree : m_trees)
+    {
+        for (size_t index : tree.tree.overlapping(rect))
+        {
+            Id other = tree.ids[index];
+            if (m_alive[other - 1] && other != id)
+            {
+                neighbours.push_back(other);
+            }
+        }
+    }
+    for (Id other : m_added)
+    {
+        if (m_alive[other - 1] && other != id && rect.intersect(m_rects[other - 1]).has_value())
+        {
+            neighbours.push_back(other);
+        }
+    }
+    // each tree's ids are greater than the previous tree's, and m_added ids greater than all of them: sorted already
+    return neighbours;
+}
+
+// Canonical enumeration again, restricted to id and its neighbours: each subset is grown in increasing order only
+std::vector<Intersection> IntersectionIndex::intersections_with(Id id) const
+{
+    struct Pending
+    {
+        Intersection inter;
+        // the neighbours it can still be extended with start here
+        size_t next;
+    };
+    std::vector<Id> neighbours = live_neighbours(id);
+    std::vector<Intersection> found;
+    std::vector<Pending> stack{Pending{.inter = Intersection(m_rects[id - 1], {id}), .next = 0}};
+    while (!stack.empty())
+    {
+        Pending pending = std::move(stack.back());
+        stack.pop_back();
+        for (size_t k = pending.next; k < neighbours.size(); k += 1)
+        {
+            auto shape = pending.inter.shape().intersect(m_rects[neighbours[k] - 1]);
+            if (shape.has_value())
+            {
+                IdSet ids = pending.inter.ids();
+                ids.insert(neighbours[k]);
+                Intersection inter(*shape, ids);
+                if (ids.size() >= m_min_degree)
+                {
+                    found.push_back(inter);
+                }
+                // like the engines, nothing is extended past max_degree
+                if (ids.size() < m_max_degree)
+                {
+                    stack.push_back(Pending{.inter = std::move(inter), .next = k + 1});
+                }
+            }
+        }
+    }
+    return found;
+}
+
+Id IntersectionIndex::add(const Rectangle &rect)
+{
+    m_rects.push_back(rect);
+    m_alive.push_back(true);
+    Id id = m_rects.size();
+    m_added.push_back(id);
+    for (Intersection &inter : intersections_with(id))
+    {
+        m_changes.push_back(Change{.kind = Change::Kind::Added, .intersection = inter});
+        m_intersections.insert(std::move(inter));
+    }
+    rebuild_if_stale();
+    return id;
+}
+
+bool IntersectionIndex::remove(Id id)
+{
+    if (!contains(id))
+    {
+        return false;
+    }
+    for (Intersection &inter : intersections_with(id))
+    {
+        m_intersections.erase(inter);
+        m_changes.push_back(Change{.kind = Change::Kind::Removed, .intersection = std::move(inter)});
+    }
+    m_alive[id - 1] = false;
+    // every id in m_added is greater than the indexed ones
+    if (m_added.empty() || id < m_added.front())
+    {
+        m_tree_removed += 1;
+    }
+    rebuild_if_stale();
+    return true;
+}
+
+bool IntersectionIndex::contains(Id id) const
+{
+    return id >= 1 && id <= m_rects.size() && m_alive[id - 1];
+}
+
+const Rectangle &IntersectionIndex::rectangle(Id id) const
+{
+    return m_rects[id - 1];
+}
+
+const std::set<Intersection> &IntersectionIndex::intersections() const
+{
+    return m_intersections;
+}
+
+std::vector<IntersectionIndex::Change> IntersectionIndex::take_changes()
+{
+    return std::exchange(m_changes, {});
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <set>
+#include <vector>
+#include "rectangle.hpp"
+#include "intersection.hpp"
+#include "rtree.hpp"
+
+/**
+ * Intersections of a changing set of rectangles, kept up to date one rectangle at a time.
+ *
+ * Every intersection a rectangle takes part in is made of it and some of the rectangles it overlaps, so adding or
+ * removing one only walks the subsets of its own neighbours rather than rerunning get_intersections.
+ * Neighbours are found through a few bulk loaded RTrees, plus a scan of the at most MIN_REBUILD rectangles added since
+ * the last one was built. The trees work like the bits of a binary counter: each new one is merged with the newer trees
+ * less than twice its size, so there are O(log n) of them and every rectangle is loaded again O(log n) times.
+ * A change then costs O(log^2 n) amortized to find the neighbours, on top of walking their subsets.
+ * Removed rectangles stay in the trees until they make up a quarter of them, and everything is loaded into one tree again.
+ *
+ * Ids are handed out in increasing order and never reused, so the ids of the intersections stay stable:
+ * intersections() is what get_intersections would return if removed rectangles were still there but overlapped nothing.
+ */
+class IntersectionIndex
+{
+public:
+    // One entry of the change feed
+    struct Change
+    {
+        enum class Kind
+        {
+            Added,
+            Removed,
+        };
+
+        Kind kind;
+        Intersection intersection;
+    };
+
+private:
+    // Added rectangles are scanned until there are this many of them, and that many removed ones at least trigger a rebuild
+    static constexpr size_t MIN_REBUILD = 64;
+
+    // An RTree over some of the rectangles, entry i is the rectangle ids[i]
+    struct Tree
+    {
+        RTree tree;
+        std::vector<Id> ids;
+    };
+
+    // Indexed by id - 1, removed rectangles are kept as tombstones
+    std::vector<Rectangle> m_rects;
+    std::vector<bool> m_alive;
+    // The degree bounds of the options, kept for every change
+    size_t m_min_degree = 2;
+    size_t m_max_degree = SIZE_MAX;
+    std::set<Intersection> m_intersections;
+    std::vector<Change> m_changes;
+
+    // Oldest first: every tree is at least twice as large as the next one, and holds smaller ids.
+    // The rectangles added since the last tree was built are in m_added, m_tree_removed of the indexed ones have been removed
+    std::vector<Tree> m_trees;
+    size_t m_tree_removed = 0;
+    std::vector<Id> m_added;
+
+    // ids in increasing order
+    Tree make_tree(std::vector<Id> ids) const;
+    void rebuild_if_stale();
+    // Live rectangles overlapping id, in increasing order
+    std::vector<Id> live_neighbours(Id id) const;
+    // Every intersection id takes part in, with the live rectangles, within the degree bounds
+    std::vector<Intersection> intersections_with(Id id) const;
+
+public:
+    IntersectionIndex() = default;
+    // Ids 1..rects.size(), like get_intersections. The initial intersections are not part of the change feed.
+    // The degree bounds of options hold for every change too, the other options only pick how the initial ones are found
+    explicit IntersectionIndex(std::vector<Rectangle> rects, const IntersectionOptions &options = {});
+
+    // The id of the new rectangle
+    Id add(const Rectangle &rect);
+    // false if there is no such rectangle, or it was removed already
+    bool remove(Id id);
+
+    bool contains(Id id) const;
+    const Rectangle &rectangle(Id id) const;
+    const std::set<Intersection> &intersections() const;
+
+    // Added and removed intersections since the last call, in the order they happened
+    std::vector<Change> take_changes();
+};
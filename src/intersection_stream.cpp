@@ -0,0 +1,104 @@
+#include "intersection_stream.hpp"
+#include "stats.hpp"
+
+template <typename T>
+bool BasicIntersectionStream<T>::uses_small_search(const std::vector<Shape> &inputs, const IntersectionOptions &options)
+{
+    return options.small_search && inputs.size() <= SMALL_SEARCH_MAX_INPUTS;
+}
+
+template <typename T>
+BasicIntersectionStream<T>::BasicIntersectionStream(const std::vector<Shape> &inputs, const IntersectionOptions &options)
+    : BasicIntersectionStream(inputs, uses_small_search(inputs, options) ? std::vector<std::pair<Id, Id>>{} : Inter::overlapping_pairs(inputs, options.broad_phase), options) {}
+
+template <typename T>
+BasicIntersectionStream<T>::BasicIntersectionStream(const std::vector<Shape> &inputs, std::vector<std::pair<Id, Id>> pairs, const IntersectionOptions &options)
+    : m_pairs(std::move(pairs)), m_memory(options.memory != nullptr ? options.memory : &m_pool), m_stack(m_memory)
+{
+    if (uses_small_search(inputs, options))
+    {
+        m_small.emplace(inputs, options);
+    }
+    else
+    {
+        m_search.emplace(inputs, m_pairs, options);
+    }
+    m_scratch.memory = m_memory;
+}
+
+template <typename T>
+std::optional<BasicIntersection<T>> BasicIntersectionStream<T>::next()
+{
+    if (m_small.has_value())
+    {
+        return m_small->next();
+    }
+    while (true)
+    {
+        if (m_stack.empty())
+        {
+            if (m_next_pair == m_pairs.size())
+            {
+                return std::nullopt;
+            }
+            auto [i, j] = m_pairs[m_next_pair];
+            m_next_pair += 1;
+            m_stack.push_back(m_search->seed(i, j, m_memory));
+        }
+        Inter inter = std::move(m_stack.back());
+        m_stack.pop_back();
+        m_search->extend(inter, m_scratch, [this](Inter &&extension)
+                        { m_stack.push_back(std::move(extension)); });
+        NITRO_HIGH_WATER(queue_high_water, m_stack.size());
+        if (m_search->within_degree_bounds(inter))
+        {
+            NITRO_COUNT(intersections_emitted, 1);
+            // copied out of m_memory, a move would keep the ids there
+            return Inter(inter.shape(), IdSet(inter.ids()));
+        }
+    }
+}
+
+template <typename T>
+typename BasicIntersectionStream<T>::iterator BasicIntersectionStream<T>::begin()
+{
+    return iterator(this);
+}
+
+template <typename T>
+std::default_sentinel_t BasicIntersectionStream<T>::end() const
+{
+    return std::default_sentinel;
+}
+
+template <typename T>
+BasicIntersectionStream<T>::iterator::iterator(BasicIntersectionStream *stream)
+    : m_stream(stream), m_current(stream->next()) {}
+
+template <typename T>
+const BasicIntersection<T> &BasicIntersectionStream<T>::iterator::operator*() const
+{
+    return *m_current;
+}
+
+template <typename T>
+typename BasicIntersectionStream<T>::iterator &BasicIntersectionStream<T>::iterator::operator++()
+{
+    m_current = m_stream->next();
+    return *this;
+}
+
+template <typename T>
+void BasicIntersectionStream<T>::iterator::operator++(int)
+{
+    ++*this;
+}
+
+template <typename T>
+bool BasicIntersectionStream<T>::iterator::operator==(std::default_sentinel_t) const
+{
+    return !m_current.has_value();
+}
+
+#define NITRO_INSTANTIATE_STREAM(T) template class BasicIntersectionStream<T>;
+NITRO_COORDINATE_TYPES(NITRO_INSTANTIATE_STREAM)
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <iterator>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+#include "intersection.hpp"
+#include "canonical_search.hpp"
+#include "small_search.hpp"
+
+/**
+ * Pull-based canonical enumeration: yields the intersections of get_intersections one at a time, as they are found.
+ *
+ * The depth first walk visits id sets in lexicographic order already, so the intersections come out in the same order
+ * std::set<Intersection> would hold them, without any reorder buffer.
+ * Only the pending extensions of the current path are held, never the result, so memory doesn't grow with the output.
+ * They are allocated from options.memory, or from a pool owned by the stream that reuses the blocks of the ones already yielded.
+ * Yielded intersections are copies in the default resource, they can outlive the stream and its memory.
+ * The inputs must outlive the stream.
+ * At most SMALL_SEARCH_MAX_INPUTS of them are walked by a SmallSearch instead (see IntersectionOptions::small_search),
+ * which holds its whole path in the stream.
+ */
+template <typename T>
+class BasicIntersectionStream
+{
+    using Shape = BasicRectangle<T>;
+    using Inter = BasicIntersection<T>;
+
+    std::vector<std::pair<Id, Id>> m_pairs;
+    // exactly one of them is set, m_small when uses_small_search
+    std::optional<CanonicalSearch<T>> m_search;
+    std::optional<SmallSearch<T, SMALL_SEARCH_MAX_INPUTS>> m_small;
+    // m_memory when options.memory is nullptr
+    std::pmr::unsynchronized_pool_resource m_pool;
+    std::pmr::memory_resource *m_memory;
+    typename CanonicalSearch<T>::Scratch m_scratch;
+    std::pmr::vector<Inter> m_stack;
+    size_t m_next_pair = 0;
+
+    static bool uses_small_search(const std::vector<Shape> &inputs, const IntersectionOptions &options);
+
+public:
+    // Single pass input iterator, see begin()
+    class iterator
+    {
+        BasicIntersectionStream *m_stream;
+        std::optional<Inter> m_current;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Inter;
+        using difference_type = std::ptrdiff_t;
+
+        explicit iterator(BasicIntersectionStream *stream);
+
+        const Inter &operator*() const;
+        iterator &operator++();
+        void operator++(int);
+        bool operator==(std::default_sentinel_t) const;
+    };
+
+    // The enumeration is always Canonical and single threaded, whatever options say
+    BasicIntersectionStream(const std::vector<Shape> &inputs, const IntersectionOptions &options = {});
+    // pairs as returned by BasicIntersection::overlapping_pairs, unused when inputs are small enough for a SmallSearch
+    BasicIntersectionStream(const std::vector<Shape> &inputs, std::vector<std::pair<Id, Id>> pairs, const IntersectionOptions &options);
+
+    // The next intersection, std::nullopt once they have all been yielded
+    std::optional<Inter> next();
+
+    // Resumes from where the stream is, so the stream can only be walked once
+    iterator begin();
+    std::default_sentinel_t end() const;
+};
+
+using IntersectionStream = BasicIntersectionStream<uint32_t>;
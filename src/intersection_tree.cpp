@@ -0,0 +1,127 @@
+#include "intersection_tree.hpp"
+#include "canonical_search.hpp"
+
+// the size the class comment promises, on 64 bit targets
+static_assert(sizeof(void *) != 8 || sizeof(IntersectionTree::Node) == 32);
+
+IntersectionTree::IntersectionTree(const std::vector<Rectangle> &inputs, const IntersectionOptions &options)
+    : m_min_degree(options.min_degree), m_max_degree(options.max_degree)
+{
+    auto pairs = Intersection::overlapping_pairs(inputs, options.broad_phase);
+    CanonicalSearch<uint32_t> search(inputs, pairs, options);
+    CanonicalSearch<uint32_t>::Scratch scratch;
+
+    // A node waiting to be stored, once its parent's earlier branches are done
+    struct Pending
+    {
+        size_t parent;
+        Id id;
+        size_t degree;
+        Rectangle shape;
+    };
+    std::vector<Pending> stack;
+    size_t root = NO_PARENT;
+    for (auto [i, j] : pairs)
+    {
+        // pairs are sorted, so all the pairs of a root come in a row
+        if (root == NO_PARENT || m_nodes[root].id != i)
+        {
+            root = m_nodes.size();
+            m_nodes.push_back(Node{.parent = NO_PARENT, .id = i, .shape = inputs[i - 1]});
+        }
+        stack.push_back(Pending{.parent = root, .id = j, .degree = 2, .shape = *inputs[i - 1].intersect(inputs[j - 1])});
+        while (!stack.empty())
+        {
+            Pending pending = stack.back();
+            stack.pop_back();
+            size_t index = m_nodes.size();
+            m_nodes.push_back(Node{.parent = pending.parent, .id = pending.id, .shape = pending.shape});
+            m_size += search.within_degree_bounds(pending.degree);
+            search.extend(pending.shape, pending.id, pending.degree, scratch, [&](Id id, const Rectangle &shape)
+                          { stack.push_back(Pending{.parent = index, .id = id, .degree = pending.degree + 1, .shape = shape}); });
+        }
+    }
+    m_nodes.shrink_to_fit();
+}
+
+size_t IntersectionTree::size() const
+{
+    return m_size;
+}
+
+const std::vector<IntersectionTree::Node> &IntersectionTree::nodes() const
+{
+    return m_nodes;
+}
+
+IdSet IntersectionTree::ids(size_t node) const
+{
+    IdSet ids;
+    for (; node != NO_PARENT; node = m_nodes[node].parent)
+    {
+        ids.insert(m_nodes[node].id);
+    }
+    return ids;
+}
+
+IntersectionTree::iterator IntersectionTree::begin() const
+{
+    return iterator(this, 0);
+}
+
+IntersectionTree::iterator IntersectionTree::end() const
+{
+    return iterator(this, m_nodes.size());
+}
+
+IntersectionTree::iterator::iterator(const IntersectionTree *tree, size_t position)
+    : m_tree(tree), m_position(position)
+{
+    settle();
+}
+
+void IntersectionTree::iterator::settle()
+{
+    m_current.reset();
+    const std::vector<Node> &nodes = m_tree->m_nodes;
+    for (; m_position < nodes.size(); m_position += 1)
+    {
+        const Node &node = nodes[m_position];
+        // the parent of a node is always on the path to the node before it
+        while (!m_path.empty() && m_path.back() != node.parent)
+        {
+            m_ids.erase(nodes[m_path.back()].id);
+            m_path.pop_back();
+        }
+        m_path.push_back(m_position);
+        m_ids.insert(node.id);
+        size_t degree = m_path.size();
+        if (degree >= 2 && degree >= m_tree->m_min_degree && degree <= m_tree->m_max_degree)
+        {
+            m_current.emplace(node.shape, m_ids);
+            return;
+        }
+    }
+}
+
+const Intersection &IntersectionTree::iterator::operator*() const
+{
+    return *m_current;
+}
+
+IntersectionTree::iterator &IntersectionTree::iterator::operator++()
+{
+    m_position += 1;
+    settle();
+    return *this;
+}
+
+void IntersectionTree::iterator::operator++(int)
+{
+    ++*this;
+}
+
+bool IntersectionTree::iterator::operator==(const iterator &other) const
+{
+    return m_position == other.m_position;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <iterator>
+#include <optional>
+#include <vector>
+#include "intersection.hpp"
+
+/**
+ * The intersections of get_intersections held as a prefix tree, for outputs too large to hold as std::set<Intersection>.
+ *
+ * The canonical enumeration builds every id set from its prefix by adding one greater id, so each intersection is stored as
+ * the index of its prefix, the id it adds and its shape: 32 bytes whatever its degree, in a single flat vector.
+ * An Intersection holds its whole id set instead, and a std::set adds a tree node around each one.
+ * The rectangles the pairs grow from are stored as roots, they are not intersections themselves.
+ *
+ * Nodes are stored depth first, which is std::set<Intersection> order. Iterating walks them front to back and rebuilds
+ * each id set from the previous one, dropping the ids of the branch it leaves and adding its own, so full id sets only
+ * exist one at a time, when they are read.
+ */
+class IntersectionTree
+{
+public:
+    static constexpr size_t NO_PARENT = SIZE_MAX;
+
+    struct Node
+    {
+        // index of the intersection with one id less, NO_PARENT for the roots
+        size_t parent;
+        // the greatest id of the intersection
+        Id id;
+        Rectangle shape;
+    };
+
+private:
+    std::vector<Node> m_nodes;
+    size_t m_min_degree;
+    size_t m_max_degree;
+    // intersections within the degree bounds, the only ones iteration yields
+    size_t m_size = 0;
+
+public:
+    // Yields the intersections within the degree bounds as Intersection objects, in std::set<Intersection> order
+    class iterator
+    {
+        const IntersectionTree *m_tree;
+        size_t m_position;
+        // nodes from the root to m_position, and their ids
+        std::vector<size_t> m_path;
+        IdSet m_ids;
+        std::optional<Intersection> m_current;
+
+        // moves to the first node from m_position on that is yielded
+        void settle();
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Intersection;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Intersection *;
+        using reference = const Intersection &;
+
+        iterator(const IntersectionTree *tree, size_t position);
+
+        const Intersection &operator*() const;
+        iterator &operator++();
+        void operator++(int);
+        bool operator==(const iterator &other) const;
+    };
+
+    // Walks the canonical enumeration on a single thread, like IntersectionStream. options.threads and enumeration are ignored
+    explicit IntersectionTree(const std::vector<Rectangle> &inputs, const IntersectionOptions &options = {});
+
+    // Number of intersections within the degree bounds
+    size_t size() const;
+    // Every node, roots and intersections below min_degree included
+    const std::vector<Node> &nodes() const;
+    // The id set of a node, rebuilt by walking up to its root
+    IdSet ids(size_t node) const;
+
+    iterator begin() const;
+    iterator end() const;
+};
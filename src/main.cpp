@@ -1,103 +1,539 @@
-#include <boost/json.hpp>
 #include <functional>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <cassert>
 #include <optional>
+#include <set>
 #include <ranges>
+#include <limits>
+#include <charconv>
+#include <algorithm>
+#include <thread>
+#include <string_view>
+#include <fstream>
+#include <type_traits>
+#include <variant>
 
 #include "rectangle.hpp"
 #include "intersection.hpp"
+#include "input.hpp"
+#include "intersection_stream.hpp"
+#include "duplicate_classes.hpp"
+#include "output.hpp"
+#include "coverage.hpp"
+#include "server.hpp"
+#include "stats.hpp"
 
 using std::string, std::vector;
 
-std::optional<boost::json::value> read_json_from_file(std::string json_string)
+// Only the first MAX_RECTS rectangles are processed, unless --all is given
+const size_t MAX_RECTS = 10;
+// Smallest worker pool of --serve, it grows to one worker per hardware thread
+const unsigned SERVE_WORKERS = 4;
+// --coverage reports depths past this one as a single bucket, the memory it needs grows with the number of depths
+const size_t MAX_COVERAGE_LEVELS = 256;
+
+const char *USAGE =
+    "Usage: main [options] <input file>\n"
+    "       main [options] --serve <socket path>\n"
+    "       main --convert <output file> <input file>\n"
+    "  Input files are JSON or binary, told apart by their first bytes. Use - as the file name to read from stdin\n"
+    "  --convert PATH   write the input file to PATH in the other format (JSON to binary, binary to JSON),\n"
+    "                   every rectangle of it, instead of processing it\n"
+    "  --serve PATH     answer requests on a Unix socket: every line is an input document,\n"
+    "                   every response is followed by an empty line\n"
+    "  --max-request N  with --serve, answer request lines longer than N bytes with an error (default 64 MiB)\n"
+    "  --all            process every rectangle in \"rects\" rather than only the first 10\n"
+    "  --maximal        only report the intersections that are not part of a larger one\n"
+    "  --coverage       report the area covered at each depth instead of the intersections\n"
+    "  --collapse-duplicates\n"
+    "                   group identical rectangles and report each group once: {1|5} stands for\n"
+    "                   rectangle 1, rectangle 5 or both. Single threaded\n"
+    "  --format F       output format: text (default), ndjson or csv\n"
+    "  --threads N      search with N worker threads, 0 for one per hardware thread (default 1)\n"
+    "  --min-degree N   only report intersections of at least N rectangles\n"
+    "  --max-degree N   only report intersections of at most N rectangles\n"
+    "  --top-k-area K   only report the K intersections with the largest area, largest first. Single threaded,\n"
+    "                   so it can't be combined with --threads other than 1\n"
+    "  The last three can't be combined with --maximal, --coverage or --collapse-duplicates,\n"
+    "  and --min-degree must be at least 2 and at most --max-degree\n"
+    "  --stats          write phase timings and engine counters to stderr as JSON, not with --serve\n"
+    "                   (the counters need a build with NITRO_STATS, see make STATS=1)\n";
+
+struct CliOptions
+{
+    string file_name;
+    // --serve, empty when reading a file
+    string socket_path;
+    // --convert, empty when processing the file
+    string convert_path;
+    bool all_rects = false;
+    bool maximal = false;
+    bool coverage = false;
+    bool collapse_duplicates = false;
+    bool stats = false;
+    unsigned threads = 1;
+    size_t max_request = Server::DEFAULT_MAX_REQUEST;
+    OutputFormat format = OutputFormat::Text;
+    size_t min_degree = 2;
+    size_t max_degree = SIZE_MAX;
+    std::optional<size_t> top_k_area;
+};
+
+// Parses argv[i + 1] as the unsigned value of the option at argv[i], and skips over it
+template <typename T>
+std::optional<T> option_value(int argc, char ** argv, int &i)
 {
-    // Parse the JSON string
-    try  {
-        return boost::json::parse(json_string);
-    } catch (const std::exception & e) {
+    if (i + 1 >= argc) {
         return std::nullopt;
     }
+    i += 1;
+    string arg = argv[i];
+    T value = 0;
+    auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    if (error != std::errc() || end != arg.data() + arg.size()) {
+        return std::nullopt;
+    }
+    return value;
 }
 
-std::optional<string> read_to_string(std::string file_path) {
-    // Read JSON from file
-    std::ifstream ifs(file_path);
-    if (!ifs.is_open())
-    {
+std::optional<CliOptions> parse_arguments(int argc, char ** argv)
+{
+    CliOptions options;
+    bool has_file = false;
+    for (int i = 1; i < argc; i += 1) {
+        string arg = argv[i];
+        if (arg == "--all") {
+            options.all_rects = true;
+        } else if (arg == "--maximal") {
+            options.maximal = true;
+        } else if (arg == "--serve") {
+            if (i + 1 >= argc) {
+                return std::nullopt;
+            }
+            i += 1;
+            options.socket_path = argv[i];
+        } else if (arg == "--convert") {
+            if (i + 1 >= argc) {
+                return std::nullopt;
+            }
+            i += 1;
+            options.convert_path = argv[i];
+        } else if (arg == "--coverage") {
+            options.coverage = true;
+        } else if (arg == "--collapse-duplicates") {
+            options.collapse_duplicates = true;
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--format") {
+            std::optional<OutputFormat> format;
+            if (i + 1 < argc) {
+                i += 1;
+                format = parse_output_format(argv[i]);
+            }
+            if (!format.has_value()) {
+                return std::nullopt;
+            }
+            options.format = *format;
+        } else if (arg == "--threads") {
+            auto threads = option_value<unsigned>(argc, argv, i);
+            if (!threads.has_value()) {
+                return std::nullopt;
+            }
+            options.threads = *threads;
+        } else if (arg == "--max-request") {
+            auto max_request = option_value<size_t>(argc, argv, i);
+            if (!max_request.has_value() || *max_request == 0) {
+                return std::nullopt;
+            }
+            options.max_request = *max_request;
+        } else if (arg == "--min-degree" || arg == "--max-degree" || arg == "--top-k-area") {
+            auto value = option_value<size_t>(argc, argv, i);
+            if (!value.has_value()) {
+                return std::nullopt;
+            }
+            if (arg == "--min-degree") {
+                options.min_degree = *value;
+            } else if (arg == "--max-degree") {
+                options.max_degree = *value;
+            } else {
+                options.top_k_area = *value;
+            }
+        } else if ((arg.starts_with("-") && arg != "-") || has_file) {
+            return std::nullopt;
+        } else {
+            options.file_name = arg;
+            has_file = true;
+        }
+    }
+    // exactly one of a file and a socket
+    if (has_file == !options.socket_path.empty()) {
         return std::nullopt;
     }
+    // a converted file is written, not answered
+    if (!options.convert_path.empty() && !options.socket_path.empty()) {
+        return std::nullopt;
+    }
+    // requests of a server run concurrently, their counters can't be told apart
+    if (options.stats && !options.socket_path.empty()) {
+        return std::nullopt;
+    }
+    bool has_query = options.min_degree != 2 || options.max_degree != SIZE_MAX || options.top_k_area.has_value();
+    int modes = options.maximal + options.coverage + options.collapse_duplicates;
+    if (modes > 1 || (modes == 1 && has_query)) {
+        return std::nullopt;
+    }
+    // an empty range of degrees would only ever answer nothing, and single rectangles are not intersections
+    if (options.min_degree < 2 || options.min_degree > options.max_degree) {
+        return std::nullopt;
+    }
+    // the top-k search keeps a single heap of the best so far, it runs on one thread
+    if (options.top_k_area.has_value() && options.threads != 1) {
+        return std::nullopt;
+    }
+    return options;
+}
+
+// The checks on the rectangles themselves, whatever the format. rules explains what a valid rectangle is
+bool report_invalid_rects(size_t rect_count, const std::vector<string> &invalid_rects, std::string_view rules, const CliOptions &options, std::ostream &os)
+{
+    if (!options.all_rects && rect_count < MAX_RECTS) {
+        os << "Improper input: \"rects\" field must contain at least 10 rectangles\n";
+        return true;
+    }
 
-    std::string str((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
-    // Close the file stream
-    ifs.close(); 
-    return str;
+    // Ids are 1-based, so the last id must still fit
+    if (rect_count >= std::numeric_limits<Id>::max()) {
+        os << "Improper input: too many rectangles\n";
+        return true;
+    }
 
+    if (!invalid_rects.empty()) {
+        // every invalid rectangle is reported, not just the first one
+        for (auto const & elem : invalid_rects) {
+            os << "Improper input: Invalid rectangle element: "  << elem << "\n";
+        }
+        os << rules;
+        return true;
+    }
+    return false;
 }
-// TODO: parse command line arguments in a nicer way
-int main(int argc, char ** argv)
+
+// Writes why a parsed input document can't be processed, if it can't. Returns whether it did
+bool report_invalid(const ParsedInput &parsed, const CliOptions &options, std::ostream &os)
 {
-    if (argc != 2) {
-        std::cout << "Please provide exactly 1 argument: the JSON file name\n";
-        return 1;
+    if (parsed.status == ParsedInput::Status::SyntaxError) {
+        os << "Improper input: Incorrect JSON syntax\n";
+        return true;
     }
-    auto file_name = std::string(argv[1]);
-    auto file_contents = read_to_string(file_name);
-    if(!file_contents.has_value()) {
-        std::cout << "Error: Could not find file \"" << file_name << "\"\n";
-        return 1;
+
+    if (parsed.status == ParsedInput::Status::NotAnObject) {
+        os << "Improper input: top level JSON must be an object\n";
+        return true;
     }
 
-    auto v_opt = read_json_from_file(*file_contents);
+    if (parsed.status == ParsedInput::Status::MissingRects) {
+        os << "Inpropper input: input JSON file must contain \"rects\" field\n";
+        return true;
+    }
+    return report_invalid_rects(parsed.rect_count, parsed.invalid_rects,
+                                " Rectangles must have exactly for fields: x, y, w, h. All of these should be parsable into uint32_t, and w and h should be at least 1\n",
+                                options, os);
+}
 
-    if (!v_opt.has_value()) {
-        std::cout << "Improper input: Incorrect JSON syntax\n";
-        return 1;
+// Same as above for a binary input document
+bool report_invalid(const BinaryInput &input, const CliOptions &options, std::ostream &os)
+{
+    if (input.status == BinaryInput::Status::BadHeader) {
+        os << "Improper input: unknown binary format version or coordinate width\n";
+        return true;
     }
 
-    boost::json::value v = *v_opt;
+    if (input.status == BinaryInput::Status::SizeMismatch) {
+        os << "Improper input: binary file size doesn't match its rectangle count\n";
+        return true;
+    }
+    return report_invalid_rects(input.rect_count, input.invalid_rects,
+                                " Rectangles must have w and h of at least 1, coordinates that fit in uint32_t "
+                                "and x + w and y + h that fit in the coordinate width\n",
+                                options, os);
+}
 
+// Writes a computed list of intersections, timed as printing
+template <typename Intersections>
+void write_all(OutputWriter &out, std::string_view title, const Intersections &intersections, PhaseTimer &timer)
+{
+    auto scope = timer.time(Phase::Print);
+    out.begin_intersections(title);
+    for (auto const & inter : intersections) {
+        out.write(inter);
+    }
+    out.end_intersections();
+    out.flush();
+}
 
+// Answers the intersection queries of options on rects, once the input listing is written. Returns the exit status
+template <typename T>
+int answer(const std::vector<BasicRectangle<T>> &rects, const CliOptions &options, OutputWriter &out, PhaseTimer &timer)
+{
+    if (options.maximal) {
+        std::set<BasicIntersection<T>> maximal;
+        {
+            auto scope = timer.time(Phase::Compute);
+            maximal = BasicIntersection<T>::get_maximal_intersections(rects);
+        }
+        write_all(out, "Maximal intersections:", maximal, timer);
+        return 0;
+    }
 
-    if (!v.is_object()) {
-        std::cout << "Improper input: top level JSON must be an object\n";
-        return 1;
+    if (options.collapse_duplicates) {
+        // written as they are found, like the stream below
+        std::optional<DuplicateClasses<T>> classes;
+        std::optional<ClassIntersectionStream<T>> stream;
+        {
+            auto scope = timer.time(Phase::Compute);
+            classes.emplace(rects);
+            stream.emplace(*classes);
+        }
+        {
+            auto scope = timer.time(Phase::Print);
+            out.begin_intersections("Intersections of duplicate classes:");
+        }
+        while (true) {
+            std::optional<ClassIntersection<T>> inter;
+            {
+                auto scope = timer.time(Phase::Compute);
+                inter = stream->next();
+            }
+            if (!inter.has_value()) {
+                break;
+            }
+            auto scope = timer.time(Phase::Print);
+            out.write(*inter, *classes);
+        }
+        auto scope = timer.time(Phase::Print);
+        out.end_intersections();
+        out.flush();
+        return 0;
     }
 
-	// will not panic due to check above
-    auto obj = v.as_object();
+    IntersectionOptions intersection_options{
+        .threads = options.threads,
+        .min_degree = options.min_degree,
+        .max_degree = options.max_degree,
+    };
+    if (options.top_k_area.has_value()) {
+        std::vector<BasicIntersection<T>> largest;
+        {
+            auto scope = timer.time(Phase::Compute);
+            largest = BasicIntersection<T>::get_largest_intersections(rects, *options.top_k_area, intersection_options);
+        }
+        write_all(out, "Largest intersections:", largest, timer);
+    } else if (options.threads != 1) {
+        // threads find intersections out of order, they have to be collected and sorted first
+        std::set<BasicIntersection<T>> all;
+        {
+            auto scope = timer.time(Phase::Compute);
+            all = BasicIntersection<T>::get_intersections(rects, intersection_options);
+        }
+        write_all(out, "Intersections:", all, timer);
+    } else {
+        // written as they are found, in the same order as the std::set above.
+        // Finding and writing alternate, so each intersection is timed on its own
+        std::optional<BasicIntersectionStream<T>> stream;
+        {
+            auto scope = timer.time(Phase::Compute);
+            stream.emplace(rects, intersection_options);
+        }
+        {
+            auto scope = timer.time(Phase::Print);
+            out.begin_intersections("Intersections:");
+        }
+        while (true) {
+            std::optional<BasicIntersection<T>> inter;
+            {
+                auto scope = timer.time(Phase::Compute);
+                inter = stream->next();
+            }
+            if (!inter.has_value()) {
+                break;
+            }
+            auto scope = timer.time(Phase::Print);
+            out.write(*inter);
+        }
+        auto scope = timer.time(Phase::Print);
+        out.end_intersections();
+        out.flush();
+    }
+    return 0;
+}
 
-	boost::json::array rects_json;
-    try {
-        rects_json = obj.at("rects").as_array();
-    } catch(const boost::json::error &) {
-        std::cout << "Inpropper input: input JSON file must contain \"rects\" field\n";
-        return 1;
+// Coverage of validated rects, on the same coordinates as the engines so no range end wraps around
+template <typename T>
+CoverageStats coverage(const std::vector<BasicRectangle<T>> &rects)
+{
+    // binary inputs are stored in the narrowest coordinates already, never narrowed any further
+    if constexpr (!std::is_same_v<T, uint32_t>) {
+        return coverage_stats(rects, MAX_COVERAGE_LEVELS);
+    } else {
+        switch (narrowest_coordinates(rects)) {
+        case CoordinateType::Uint16:
+            return coverage_stats(convert_rectangles<uint16_t>(rects), MAX_COVERAGE_LEVELS);
+        case CoordinateType::Uint32:
+            return coverage_stats(rects, MAX_COVERAGE_LEVELS);
+        case CoordinateType::Uint64:
+        default:
+            return coverage_stats(convert_rectangles<uint64_t>(rects), MAX_COVERAGE_LEVELS);
+        }
     }
+}
 
-    if (rects_json.size() < 10) {
-        std::cout << "Improper input: \"rects\" field must contain at least 10 rectangles\n";
-        return 1;
+// Writes the input listing of validated rects and answers the queries of options on them. Returns the exit status
+template <typename T>
+int process_rects(const std::vector<BasicRectangle<T>> &rects, const CliOptions &options, std::ostream &os, PhaseTimer &timer)
+{
+    OutputWriter out(os, options.format);
+    {
+        auto scope = timer.time(Phase::Print);
+        out.write_inputs(rects);
+    }
+    if (options.coverage) {
+        CoverageStats stats;
+        {
+            auto scope = timer.time(Phase::Compute);
+            stats = coverage(rects);
+        }
+        auto scope = timer.time(Phase::Print);
+        out.write_coverage(stats);
+        out.flush();
+        return 0;
     }
+    // binary inputs are stored in the narrowest coordinates already, JSON ones are always parsed as uint32_t
+    if constexpr (!std::is_same_v<T, uint32_t>) {
+        return answer(rects, options, out, timer);
+    } else {
+        // the engines run on the narrowest coordinates that hold every range end
+        switch (narrowest_coordinates(rects)) {
+        case CoordinateType::Uint16:
+            return answer(convert_rectangles<uint16_t>(rects), options, out, timer);
+        case CoordinateType::Uint32:
+            return answer(rects, options, out, timer);
+        case CoordinateType::Uint64:
+        default:
+            return answer(convert_rectangles<uint64_t>(rects), options, out, timer);
+        }
+    }
+}
 
-	vector<Rectangle> rects;
-    int count = 0;
-    for (auto const & elem : rects_json | std::views::take(10)) {
-        auto rect_opt = Rectangle::create(elem);
-        if(!rect_opt.has_value()) {
-            std::cout << "Improper input: Invalid rectangle element: "  << elem << "\n Rectangles must have exactly for fields: x, y, w, h. All of these should be parsable into uint32_t\n";
+// Answers one input document, the way main prints it. Returns the exit status.
+// The time spent in each phase is added to timer, reading a binary document counts as parsing it
+int process(std::string_view contents, const CliOptions &options, std::ostream &os, PhaseTimer &timer)
+{
+    size_t limit = options.all_rects ? SIZE_MAX : MAX_RECTS;
+    if (is_binary_input(contents)) {
+        BinaryInput input;
+        {
+            auto scope = timer.time(Phase::Parse);
+            input = read_binary_rects(contents, limit);
+        }
+        bool invalid;
+        {
+            auto scope = timer.time(Phase::Validate);
+            invalid = report_invalid(input, options, os);
+        }
+        if (invalid) {
             return 1;
-        } 
-        rects.push_back(*rect_opt);
+        }
+        return std::visit([&](const auto &rects) { return process_rects(rects, options, os, timer); }, input.rects);
     }
 
-    std::cout << "Input:\n";
-    std::cout << rects;
-    std::cout << "Intersections:\n";
+    ParsedInput parsed;
+    {
+        auto scope = timer.time(Phase::Parse);
+        parsed = parse_rects(contents, limit);
+    }
+    bool invalid;
+    {
+        auto scope = timer.time(Phase::Validate);
+        invalid = report_invalid(parsed, options, os);
+    }
+    if (invalid) {
+        return 1;
+    }
+    return process_rects(parsed.rects, options, os, timer);
+}
 
-    auto result = Intersection::get_intersections(rects);
-    std::cout << result;
+// Writes every rectangle of an input document to path in the other format. Returns the exit status
+int convert(std::string_view contents, const string &path, const CliOptions &options)
+{
+    CliOptions every_rect = options;
+    every_rect.all_rects = true;
+    std::vector<Rectangle> rects;
+    string document;
+    if (is_binary_input(contents)) {
+        BinaryInput input = read_binary_rects(contents, SIZE_MAX);
+        if (report_invalid(input, every_rect, std::cout)) {
+            return 1;
+        }
+        // every coordinate fits in uint32_t
+        rects = std::visit([](const auto &stored) { return convert_rectangles<uint32_t>(stored); }, input.rects);
+        document = json_rects_document(rects);
+    } else {
+        ParsedInput parsed = parse_rects(contents, SIZE_MAX);
+        if (report_invalid(parsed, every_rect, std::cout)) {
+            return 1;
+        }
+        rects = std::move(parsed.rects);
+        document = binary_rects_document(rects);
+    }
+    std::ofstream file(path, std::ios::binary);
+    if (!file.write(document.data(), document.size()) || !file.flush()) {
+        std::cout << "Error: Could not write \"" << path << "\"\n";
+        return 1;
+    }
+    std::cout << "Wrote " << rects.size() << " rectangles to \"" << path << "\"\n";
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char ** argv)
+{
+    auto options = parse_arguments(argc, argv);
+    if (!options.has_value()) {
+        std::cout << "Improper arguments: give one input file, or --serve with a socket path, and only the options below that go together\n" << USAGE;
+        return 1;
+    }
+    if (!options->socket_path.empty()) {
+        auto server = Server::listen(options->socket_path);
+        if (!server.has_value()) {
+            std::cout << "Error: Could not listen on \"" << options->socket_path << "\"\n";
+            return 1;
+        }
+        // every request is a whole input document on a single line
+        server->run([&options](std::string_view request, std::ostream &response)
+                    {
+                        PhaseTimer timer(false);
+                        process(request, *options, response, timer); },
+                    std::max(SERVE_WORKERS, std::thread::hardware_concurrency()), options->max_request);
+        return 0;
+    }
+    PhaseTimer timer(options->stats);
+    auto file_name = options->file_name;
+    std::optional<InputFile> file;
+    {
+        auto scope = timer.time(Phase::Read);
+        file = InputFile::open(file_name);
+    }
+    if(!file.has_value()) {
+        std::cout << "Error: Could not find file \"" << file_name << "\"\n";
+        return 1;
+    }
+    if (!options->convert_path.empty()) {
+        return convert(file->contents(), options->convert_path, *options);
+    }
+    int status = process(file->contents(), *options, std::cout, timer);
+    if (options->stats) {
+        std::cout.flush();
+        write_stats(std::cerr, timer, Stats::totals());
+    }
+    return status;
+}
@@ -0,0 +1,338 @@
+#include <charconv>
+#include <type_traits>
+#include "output.hpp"
+
+std::optional<OutputFormat> parse_output_format(std::string_view name)
+{
+    if (name == "text")
+    {
+        return OutputFormat::Text;
+    }
+    if (name == "ndjson")
+    {
+        return OutputFormat::Ndjson;
+    }
+    if (name == "csv")
+    {
+        return OutputFormat::Csv;
+    }
+    return std::nullopt;
+}
+
+OutputWriter::OutputWriter(std::ostream &os, OutputFormat format)
+    : m_os(os), m_format(format)
+{
+    m_buffer.reserve(FLUSH_SIZE + 256);
+}
+
+OutputWriter::~OutputWriter()
+{
+    flush();
+}
+
+void OutputWriter::append(std::string_view text)
+{
+    m_buffer.append(text);
+}
+
+void OutputWriter::append(uint64_t value)
+{
+    char digits[20];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    m_buffer.append(digits, end);
+}
+
+template <typename N>
+void OutputWriter::append_number(N value)
+{
+    // room for any 64 bit integer with its sign, floats are shorter
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    m_buffer.append(digits, end);
+}
+
+namespace
+{
+
+// Coordinates are printed as uint64_t, int64_t or float, so all the unsigned coordinate types share one formatter
+template <typename T>
+using Printed = std::conditional_t<std::is_floating_point_v<T>, T, std::conditional_t<std::is_unsigned_v<T>, uint64_t, int64_t>>;
+
+template <typename T>
+BasicRectCoors<Printed<T>> printed(const BasicRectangle<T> &rect)
+{
+    return {.x = rect.m_x, .y = rect.m_y, .w = rect.m_w, .h = rect.m_h};
+}
+
+} // namespace
+
+// "1<separator>2<last_separator>3", or "{}" like operator<<(std::ostream &, const IdSet &) for less than 2 ids
+void OutputWriter::append_ids(const IdSet &ids, std::string_view separator, std::string_view last_separator)
+{
+    size_t remaining = ids.size();
+    if (m_format == OutputFormat::Text && remaining < 2)
+    {
+        append("{}");
+        return;
+    }
+    bool first = true;
+    for (Id id : ids)
+    {
+        if (!first)
+        {
+            append(remaining == 1 ? last_separator : separator);
+        }
+        append(uint64_t{id});
+        first = false;
+        remaining -= 1;
+    }
+}
+
+void OutputWriter::flush_if_full()
+{
+    if (m_buffer.size() >= FLUSH_SIZE)
+    {
+        flush();
+    }
+}
+
+template <typename T>
+void OutputWriter::write_inputs(const std::vector<BasicRectangle<T>> &rects)
+{
+    if (m_format != OutputFormat::Text)
+    {
+        return;
+    }
+    append("Input:\n");
+    for (size_t i = 0; i < rects.size(); i += 1)
+    {
+        write_input(i + 1, printed(rects[i]));
+        flush_if_full();
+    }
+}
+
+template <typename N>
+void OutputWriter::write_input(size_t id, const BasicRectCoors<N> &rect)
+{
+    append("\t");
+    append(uint64_t{id});
+    append(": Rectangle at (");
+    append_number(rect.x);
+    append(",");
+    append_number(rect.y);
+    append("), w=");
+    append_number(rect.w);
+    append(", h=");
+    append_number(rect.h);
+    append(".\n");
+}
+
+void OutputWriter::begin_intersections(std::string_view title)
+{
+    if (m_format == OutputFormat::Text)
+    {
+        append(title);
+        append("\n");
+    }
+    else if (m_format == OutputFormat::Csv)
+    {
+        append("ids,x,y,w,h\n");
+    }
+}
+
+template <typename T>
+void OutputWriter::write(const BasicIntersection<T> &inter)
+{
+    write_record(inter.ids(), printed(inter.shape()));
+}
+
+template <typename N>
+void OutputWriter::write_record(const IdSet &ids, const BasicRectCoors<N> &shape)
+{
+    switch (m_format)
+    {
+    case OutputFormat::Text:
+        append("\tBetween rectangle ");
+        append_ids(ids, ", ", " and ");
+        break;
+    case OutputFormat::Ndjson:
+        append("{\"ids\":[");
+        append_ids(ids, ",", ",");
+        append("]");
+        break;
+    case OutputFormat::Csv:
+        append_ids(ids, " ", " ");
+        break;
+    }
+    write_shape(shape);
+}
+
+template <typename T>
+void OutputWriter::write(const ClassIntersection<T> &inter, const DuplicateClasses<T> &classes)
+{
+    switch (m_format)
+    {
+    case OutputFormat::Text:
+        append("\tBetween rectangle ");
+        break;
+    case OutputFormat::Ndjson:
+        append("{\"classes\":[");
+        break;
+    case OutputFormat::Csv:
+        break;
+    }
+    append_classes(inter, classes);
+    if (m_format == OutputFormat::Ndjson)
+    {
+        append("]");
+    }
+    write_shape(printed(inter.shape));
+}
+
+// Classes of several rectangles as {1|5}, lone ones as their id, separated like the ids of a plain record
+template <typename T>
+void OutputWriter::append_classes(const ClassIntersection<T> &inter, const DuplicateClasses<T> &classes)
+{
+    bool ndjson = m_format == OutputFormat::Ndjson;
+    for (size_t k = 0; k < inter.classes.size(); k += 1)
+    {
+        if (k > 0)
+        {
+            append(m_format == OutputFormat::Csv ? " " : ndjson ? "," : k + 1 == inter.classes.size() ? " and " : ", ");
+        }
+        auto ids = classes.ids(inter.classes[k]);
+        bool braced = ndjson || (m_format == OutputFormat::Text && ids.size() > 1);
+        append(!braced ? "" : ndjson ? "[" : "{");
+        for (size_t i = 0; i < ids.size(); i += 1)
+        {
+            if (i > 0)
+            {
+                append(ndjson ? "," : "|");
+            }
+            append(uint64_t{ids[i]});
+        }
+        append(!braced ? "" : ndjson ? "]" : "}");
+    }
+}
+
+template <typename N>
+void OutputWriter::write_shape(const BasicRectCoors<N> &shape)
+{
+    switch (m_format)
+    {
+    case OutputFormat::Text:
+        append(" at Rectangle(x=");
+        append_number(shape.x);
+        append(", y=");
+        append_number(shape.y);
+        append(", w=");
+        append_number(shape.w);
+        append(", h=");
+        append_number(shape.h);
+        append(")\n");
+        break;
+    case OutputFormat::Ndjson:
+        append(",\"x\":");
+        append_number(shape.x);
+        append(",\"y\":");
+        append_number(shape.y);
+        append(",\"w\":");
+        append_number(shape.w);
+        append(",\"h\":");
+        append_number(shape.h);
+        append("}\n");
+        break;
+    case OutputFormat::Csv:
+        append(",");
+        append_number(shape.x);
+        append(",");
+        append_number(shape.y);
+        append(",");
+        append_number(shape.w);
+        append(",");
+        append_number(shape.h);
+        append("\n");
+        break;
+    }
+    flush_if_full();
+}
+
+void OutputWriter::end_intersections()
+{
+    if (m_format == OutputFormat::Text)
+    {
+        append("]");
+    }
+}
+
+void OutputWriter::write_coverage(const CoverageStats &stats)
+{
+    switch (m_format)
+    {
+    case OutputFormat::Text:
+        append("Coverage:\n\tMax depth: ");
+        append(uint64_t{stats.max_depth});
+        append("\n");
+        break;
+    case OutputFormat::Ndjson:
+        append("{\"max_depth\":");
+        append(uint64_t{stats.max_depth});
+        append("}\n");
+        break;
+    case OutputFormat::Csv:
+        append("depth,or_more,area,area_at_least,max_depth\n");
+        break;
+    }
+    for (size_t depth = 1; depth <= stats.levels; depth += 1)
+    {
+        // the last level also holds the deeper ones when they were cut off
+        bool capped = depth == stats.levels && stats.levels < stats.max_depth;
+        switch (m_format)
+        {
+        case OutputFormat::Text:
+            append("\tDepth ");
+            append(uint64_t{depth});
+            append(capped ? " or more: area " : ": area ");
+            append(area_digits(stats.depth_area[depth]));
+            append(", covered by at least ");
+            append(uint64_t{depth});
+            append(depth == 1 ? " rectangle: " : " rectangles: ");
+            append(area_digits(stats.area_at_least[depth]));
+            append("\n");
+            break;
+        case OutputFormat::Ndjson:
+            append("{\"depth\":");
+            append(uint64_t{depth});
+            append(capped ? ",\"or_more\":true" : ",\"or_more\":false");
+            append(",\"area\":");
+            append(area_digits(stats.depth_area[depth]));
+            append(",\"area_at_least\":");
+            append(area_digits(stats.area_at_least[depth]));
+            append("}\n");
+            break;
+        case OutputFormat::Csv:
+            append(uint64_t{depth});
+            append(capped ? ",true," : ",false,");
+            append(area_digits(stats.depth_area[depth]));
+            append(",");
+            append(area_digits(stats.area_at_least[depth]));
+            append(",");
+            append(uint64_t{stats.max_depth});
+            append("\n");
+            break;
+        }
+    }
+}
+
+void OutputWriter::flush()
+{
+    m_os.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    m_os.flush();
+    m_buffer.clear();
+}
+
+#define NITRO_INSTANTIATE_OUTPUT(T)                                                  \
+    template void OutputWriter::write_inputs(const std::vector<BasicRectangle<T>> &rects); \
+    template void OutputWriter::write(const BasicIntersection<T> &inter);                  \
+    template void OutputWriter::write(const ClassIntersection<T> &inter, const DuplicateClasses<T> &classes);
+NITRO_COORDINATE_TYPES(NITRO_INSTANTIATE_OUTPUT)
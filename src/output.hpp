@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "rectangle.hpp"
+#include "intersection.hpp"
+#include "coverage.hpp"
+#include "duplicate_classes.hpp"
+
+enum class OutputFormat
+{
+    // The human readable listing main has always printed
+    Text,
+    // One JSON object per intersection and line: {"ids":[1,2],"x":0,"y":0,"w":1,"h":1}
+    Ndjson,
+    // A header line, then ids,x,y,w,h rows with the ids separated by spaces
+    Csv,
+};
+
+// "text", "ndjson" or "csv"
+std::optional<OutputFormat> parse_output_format(std::string_view name);
+
+/**
+ * Buffered writer of main's output.
+ *
+ * Text is formatted with std::to_chars into a reusable buffer that only goes to the stream once it is large,
+ * so a million lines cost a few hundred write calls rather than millions of operator<< calls and flushes.
+ * The Text format is byte for byte what the operator<< overloads print.
+ * Call flush() (or destroy the writer) before writing to the stream directly.
+ */
+class OutputWriter
+{
+    // the buffer goes to the stream once it holds this many bytes
+    static constexpr size_t FLUSH_SIZE = 1 << 16;
+
+    std::ostream &m_os;
+    OutputFormat m_format;
+    std::string m_buffer;
+
+    void append(std::string_view text);
+    void append(uint64_t value);
+    // uint64_t, int64_t or float, floats in their shortest round trip form
+    template <typename N>
+    void append_number(N value);
+    void append_ids(const IdSet &ids, std::string_view separator, std::string_view last_separator);
+    template <typename T>
+    void append_classes(const ClassIntersection<T> &inter, const DuplicateClasses<T> &classes);
+    void flush_if_full();
+    // The Text input line of a rectangle, and the record of an intersection in any format
+    template <typename N>
+    void write_input(size_t id, const BasicRectCoors<N> &rect);
+    template <typename N>
+    void write_record(const IdSet &ids, const BasicRectCoors<N> &shape);
+    // What follows the ids in a record
+    template <typename N>
+    void write_shape(const BasicRectCoors<N> &shape);
+
+public:
+    OutputWriter(std::ostream &os, OutputFormat format);
+    OutputWriter(const OutputWriter &) = delete;
+    OutputWriter &operator=(const OutputWriter &) = delete;
+    ~OutputWriter();
+
+    // The input listing. Only the Text format has one
+    template <typename T>
+    void write_inputs(const std::vector<BasicRectangle<T>> &rects);
+    // Starts the list of intersections, title is only printed by the Text format
+    void begin_intersections(std::string_view title);
+    template <typename T>
+    void write(const BasicIntersection<T> &inter);
+    // A compressed record: "{1|5} and 3" in the Text format, {"classes":[[1,5],[3]],...} in NDJSON and 1|5 3 in CSV
+    template <typename T>
+    void write(const ClassIntersection<T> &inter, const DuplicateClasses<T> &classes);
+    void end_intersections();
+
+    // Text lists the area at every depth. NDJSON starts with a max_depth record, then has one record per depth, and CSV
+    // one row per depth with max_depth as its last column. When stats.levels < stats.max_depth, the last depth stands
+    // for that many rectangles or more, which NDJSON and CSV flag with or_more
+    void write_coverage(const CoverageStats &stats);
+
+    void flush();
+};
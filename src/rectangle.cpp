@@ -7,13 +7,14 @@
 
 using std::vector, std::string;
 
-Rectangle::Rectangle(RectCoors const &coors)
+template <typename T>
+BasicRectangle<T>::BasicRectangle(BasicRectCoors<T> const &coors)
 {
 
 
     // Negative starting coordinates seem to not be used in the examples
     // I will assume they will always be positive
-    // uint32_t fits these criteria by definition
+    // the unsigned coordinate types fit these criteria by definition
     // assert(coors.x >= 0 && coors.y >= 0)
     
     // zero height or width rectangles are not rectangles, but lines
@@ -26,8 +27,9 @@ Rectangle::Rectangle(RectCoors const &coors)
 }
 
 // Creates a Rectangle from a json object, according to business rules
-// Object should have only 4 fields, x,y,w and h, each of those with a uint32_t-parsable value
-std::optional<Rectangle> Rectangle::create(boost::json::value const & v) {
+// Object should have only 4 fields, x,y,w and h, each of those with a T-parsable value
+template <typename T>
+std::optional<BasicRectangle<T>> BasicRectangle<T>::create(boost::json::value const & v) {
     using namespace boost::json;
 
     if (!v.is_object()) {
@@ -42,12 +44,12 @@ std::optional<Rectangle> Rectangle::create(boost::json::value const & v) {
     }
 
     try {
-        uint32_t x = value_to<uint32_t>(obj.at("x"));
-        uint32_t y = value_to<uint32_t>(obj.at("y"));
-        uint32_t w = value_to<uint32_t>(obj.at("w"));
-        uint32_t h = value_to<uint32_t>(obj.at("h"));
+        T x = value_to<T>(obj.at("x"));
+        T y = value_to<T>(obj.at("y"));
+        T w = value_to<T>(obj.at("w"));
+        T h = value_to<T>(obj.at("h"));
 
-        return Rectangle({.x = x, .y = y, .w = w, .h = h}); 
+        return BasicRectangle({.x = x, .y = y, .w = w, .h = h}); 
 
     } catch (const std::exception&) {
         // Catch any type mismatch or other JSON errors
@@ -55,14 +57,21 @@ std::optional<Rectangle> Rectangle::create(boost::json::value const & v) {
     }
 }
 
+template <typename T>
+typename BasicRectangle<T>::Area BasicRectangle<T>::area() const
+{
+    return static_cast<Area>(m_w) * m_h;
+}
+
 // Intersection is computed by projecting the Rectangle onto the x and y-axis
 // and then calculating range intersection on those axis
-std::optional<Rectangle> Rectangle::intersect(const Rectangle &other) const
+template <typename T>
+std::optional<BasicRectangle<T>> BasicRectangle<T>::intersect(const BasicRectangle &other) const
 {
     // Determine the start of the intersection range
-    uint32_t start_x = std::max(m_x, other.m_x);
+    T start_x = std::max(m_x, other.m_x);
     // Determine the end of the intersection range
-    uint32_t end_x = std::min(m_x + m_w, other.m_x + other.m_w);
+    T end_x = std::min(x_end(), other.x_end());
 
 	// No intersection found in x-axis
     if (start_x >= end_x)
@@ -71,9 +80,9 @@ std::optional<Rectangle> Rectangle::intersect(const Rectangle &other) const
     }
 
     // Determine the start of the intersection range
-    uint32_t start_y = std::max(m_y, other.m_y);
+    T start_y = std::max(m_y, other.m_y);
     // Determine the end of the intersection range
-    uint32_t end_y = std::min(m_y + m_h, other.m_y + other.m_h);
+    T end_y = std::min(y_end(), other.y_end());
 
 	// No intersection found in y-axis
     if (start_y >= end_y)
@@ -81,26 +90,29 @@ std::optional<Rectangle> Rectangle::intersect(const Rectangle &other) const
         return std::nullopt;
     }
 
-    return Rectangle({
+    return BasicRectangle({
         .x = start_x,
         .y = start_y,
-        .w = end_x - start_x,
-        .h = end_y - start_y,
+        .w = static_cast<T>(end_x - start_x),
+        .h = static_cast<T>(end_y - start_y),
     });
 }
 
-bool operator==(const Rectangle &lhs, const Rectangle &rhs)
+template <typename T>
+bool operator==(const BasicRectangle<T> &lhs, const BasicRectangle<T> &rhs)
 {
     return lhs.m_x == rhs.m_x && lhs.m_y == rhs.m_y && lhs.m_w == rhs.m_w && lhs.m_h == rhs.m_h;
 }
 
-std::ostream &operator<<(std::ostream &os, const Rectangle &rect)
+template <typename T>
+std::ostream &operator<<(std::ostream &os, const BasicRectangle<T> &rect)
 {
     os << "Rectangle(x=" << rect.m_x << ", y=" << rect.m_y << ", w=" << rect.m_w << ", h=" << rect.m_h << ")";
     return os;
 }
 
-std::ostream &operator<<(std::ostream &os, const std::vector<Rectangle> &v)
+template <typename T>
+std::ostream &operator<<(std::ostream &os, const std::vector<BasicRectangle<T>> &v)
 {
     for(uintptr_t i = 0; i < v.size(); i += 1 ) {
         auto rect = v[i];
@@ -108,3 +120,10 @@ std::ostream &operator<<(std::ostream &os, const std::vector<Rectangle> &v)
     }
     return os;
 }
+
+#define NITRO_INSTANTIATE_RECTANGLE(T)                                                           \
+    template class BasicRectangle<T>;                                                           \
+    template bool operator==(const BasicRectangle<T> &lhs, const BasicRectangle<T> &rhs);       \
+    template std::ostream &operator<<(std::ostream &os, const BasicRectangle<T> &rect);         \
+    template std::ostream &operator<<(std::ostream &os, const std::vector<BasicRectangle<T>> &v);
+NITRO_COORDINATE_TYPES(NITRO_INSTANTIATE_RECTANGLE)
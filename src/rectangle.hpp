@@ -1,35 +1,100 @@
-#pragma once 
+#pragma once
 
 #include <boost/json.hpp>
+#include <cstdint>
 #include <iostream>
 #include <optional>
+#include <type_traits>
+#include <vector>
 #include <cassert>
 
+// The coordinate types BasicRectangle and the engine are instantiated for, as X(type) X(type) ...
+#define NITRO_COORDINATE_TYPES(X) X(uint16_t) X(uint32_t) X(uint64_t) X(int32_t) X(float)
 
-// u_int32_t gives us a concrete size that is machine-independent 
-struct RectCoors {
-    uint32_t x;
-    uint32_t y;
-    uint32_t w;
-    uint32_t h;
+// Fixed size integers give us a concrete size that is machine-independent
+template <typename T>
+struct BasicRectCoors {
+    T x;
+    T y;
+    T w;
+    T h;
 };
 
-class Rectangle {
+/**
+ * A rectangle with coordinates of type T.
+ *
+ * The ends of its ranges, m_x + m_w and m_y + m_h, are computed in T as well: narrow types keep more boxes per SIMD register,
+ * but every end has to fit in T. The loader picks the narrowest type where they do (see narrowest_coordinates).
+ * An end that doesn't fit wraps around, signed ones included, and such a rectangle never intersects anything.
+ */
+template <typename T>
+class BasicRectangle {
 public:
-    uint32_t m_x;
-    uint32_t m_y;
-    uint32_t m_w;
-    uint32_t m_h;
+    using Coordinate = T;
+    // w * h: doubles for float, uint64_t otherwise, which can't overflow up to 32 bit coordinates
+    using Area = std::conditional_t<std::is_floating_point_v<T>, double, uint64_t>;
 
-	// Why not accepting 4 uint32_t args? Because I'm very prone to mix up the order of the arguments
-    // Using RectCoors allows using designated initializer lists, which prevents order mess-ups
-    Rectangle(RectCoors const &coors);
-    static std::optional<Rectangle> create(boost::json::value const & v);
+    T m_x;
+    T m_y;
+    T m_w;
+    T m_h;
 
-    std::optional<Rectangle> intersect(const Rectangle &other) const;
+	// Why not accepting 4 T args? Because I'm very prone to mix up the order of the arguments
+    // Using BasicRectCoors allows using designated initializer lists, which prevents order mess-ups
+    BasicRectangle(BasicRectCoors<T> const &coors);
+    static std::optional<BasicRectangle> create(boost::json::value const & v);
+
+    std::optional<BasicRectangle> intersect(const BasicRectangle &other) const;
+    Area area() const;
+
+    T x_end() const
+    {
+        return range_end(m_x, m_w);
+    }
+
+    T y_end() const
+    {
+        return range_end(m_y, m_h);
+    }
+
+private:
+    // Integers are added in their unsigned counterpart and converted back, so an end that doesn't fit wraps around
+    // on int32_t too rather than being a signed overflow
+    static T range_end(T start, T length)
+    {
+        if constexpr (std::is_integral_v<T>) {
+            using Unsigned = std::make_unsigned_t<T>;
+            return static_cast<T>(static_cast<Unsigned>(static_cast<Unsigned>(start) + static_cast<Unsigned>(length)));
+        } else {
+            return start + length;
+        }
+    }
 };
 
+using RectCoors = BasicRectCoors<uint32_t>;
+using Rectangle = BasicRectangle<uint32_t>;
+
+// rects with their coordinates converted to To, which must hold them
+template <typename To, typename From>
+std::vector<BasicRectangle<To>> convert_rectangles(const std::vector<BasicRectangle<From>> &rects)
+{
+    std::vector<BasicRectangle<To>> converted;
+    converted.reserve(rects.size());
+    for (const auto &rect : rects) {
+        converted.push_back(BasicRectangle<To>({
+            .x = static_cast<To>(rect.m_x),
+            .y = static_cast<To>(rect.m_y),
+            .w = static_cast<To>(rect.m_w),
+            .h = static_cast<To>(rect.m_h),
+        }));
+    }
+    return converted;
+}
+
 // Operator overloads
-bool operator==(const Rectangle &lhs, const Rectangle &rhs);
-std::ostream &operator<<(std::ostream &os, const Rectangle &rect);
-std::ostream &operator<<(std::ostream &os, const std::vector<Rectangle> &v);
\ No newline at end of file
+template <typename T>
+bool operator==(const BasicRectangle<T> &lhs, const BasicRectangle<T> &rhs);
+template <typename T>
+std::ostream &operator<<(std::ostream &os, const BasicRectangle<T> &rect);
+template <typename T>
+std::ostream &operator<<(std::ostream &os, const std::vector<BasicRectangle<T>> &v);
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <bit>
+#include <type_traits>
+#include "rectangle_soa.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NITRO_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+// a box as its half-open coordinate ranges
+template <typename T>
+struct Box
+{
+    T x, y, x2, y2;
+};
+
+template <typename T>
+struct Columns
+{
+    const T *x, *y, *x2, *y2;
+};
+
+template <typename T>
+struct OutColumns
+{
+    T *x, *y, *x2, *y2;
+};
+
+// Same arithmetic as BasicRectangle::intersect. Handles candidates [from, n)
+template <typename T>
+size_t clip_scalar(Box<T> s, Columns<T> in, size_t from, size_t n, OutColumns<T> out, uint64_t *hits)
+{
+    size_t count = 0;
+    for (size_t i = from; i < n; i += 1)
+    {
+        T x = std::max(s.x, in.x[i]);
+        T x2 = std::min(s.x2, in.x2[i]);
+        T y = std::max(s.y, in.y[i]);
+        T y2 = std::min(s.y2, in.y2[i]);
+        out.x[i] = x;
+        out.y[i] = y;
+        out.x2[i] = x2;
+        out.y2[i] = y2;
+        uint64_t hit = x < x2 && y < y2;
+        hits[i / 64] |= hit << (i % 64);
+        count += hit;
+    }
+    return count;
+}
+
+#ifdef NITRO_X86
+
+// There is no unsigned compare before AVX-512: flipping the sign bit turns it into a signed one
+
+__attribute__((target("sse4.2"))) size_t clip_sse42(Box<uint32_t> s, Columns<uint32_t> in, size_t n, OutColumns<uint32_t> out, uint64_t *hits)
+{
+    const __m128i sign = _mm_set1_epi32(INT32_MIN);
+    const __m128i sx = _mm_set1_epi32(s.x), sy = _mm_set1_epi32(s.y);
+    const __m128i sx2 = _mm_set1_epi32(s.x2), sy2 = _mm_set1_epi32(s.y2);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_max_epu32(sx, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in.x + i)));
+        __m128i x2 = _mm_min_epu32(sx2, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in.x2 + i)));
+        __m128i y = _mm_max_epu32(sy, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in.y + i)));
+        __m128i y2 = _mm_min_epu32(sy2, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in.y2 + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.x + i), x);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.x2 + i), x2);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.y + i), y);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.y2 + i), y2);
+        __m128i hit_x = _mm_cmpgt_epi32(_mm_xor_si128(x2, sign), _mm_xor_si128(x, sign));
+        __m128i hit_y = _mm_cmpgt_epi32(_mm_xor_si128(y2, sign), _mm_xor_si128(y, sign));
+        uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(hit_x, hit_y)));
+        // i is a multiple of 4, so the 4 bits never straddle two words
+        hits[i / 64] |= uint64_t{mask} << (i % 64);
+        count += std::popcount(mask);
+    }
+    return count + clip_scalar(s, in, i, n, out, hits);
+}
+
+__attribute__((target("avx2"))) size_t clip_avx2(Box<uint32_t> s, Columns<uint32_t> in, size_t n, OutColumns<uint32_t> out, uint64_t *hits)
+{
+    const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+    const __m256i sx = _mm256_set1_epi32(s.x), sy = _mm256_set1_epi32(s.y);
+    const __m256i sx2 = _mm256_set1_epi32(s.x2), sy2 = _mm256_set1_epi32(s.y2);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i x = _mm256_max_epu32(sx, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in.x + i)));
+        __m256i x2 = _mm256_min_epu32(sx2, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in.x2 + i)));
+        __m256i y = _mm256_max_epu32(sy, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in.y + i)));
+        __m256i y2 = _mm256_min_epu32(sy2, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in.y2 + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.x + i), x);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.x2 + i), x2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.y + i), y);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.y2 + i), y2);
+        __m256i hit_x = _mm256_cmpgt_epi32(_mm256_xor_si256(x2, sign), _mm256_xor_si256(x, sign));
+        __m256i hit_y = _mm256_cmpgt_epi32(_mm256_xor_si256(y2, sign), _mm256_xor_si256(y, sign));
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(hit_x, hit_y)));
+        // i is a multiple of 8, so the 8 bits never straddle two words
+        hits[i / 64] |= uint64_t{mask} << (i % 64);
+        count += std::popcount(mask);
+    }
+    return count + clip_scalar(s, in, i, n, out, hits);
+}
+
+// Same as above with uint16_t boxes, twice as many per register.
+// The compare results are packed from 16 to 8 bits per lane so movemask gives one bit per box
+
+__attribute__((target("sse4.2"))) size_t clip_sse42(Box<uint16_t> s, Columns<uint16_t> in, size_t n, OutColumns<uint16_t> out, uint64_t *hits)
+{
+    const __m128i sign = _mm_set1_epi16(INT16_MIN);
+    const __m128i sx = _mm_set1_epi16(static_cast<int16_t>(s.x)), sy = _mm_set1_epi16(static_cast<int16_t>(s.y));
+    const __m128i sx2 = _mm_set1_epi16(static_cast<int16_t>(s.x2)), sy2 = _mm_set1_epi16(static_cast<int16_t>(s.y2));
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i x = _mm_max_epu16(sx, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in.x + i)));
+        __m128i x2 = _mm_min_epu16(sx2, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in.x2 + i)));
+        __m128i y = _mm_max_epu16(sy, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in.y + i)));
+        __m128i y2 = _mm_min_epu16(sy2, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in.y2 + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.x + i), x);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.x2 + i), x2);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.y + i), y);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out.y2 + i), y2);
+        __m128i hit_x = _mm_cmpgt_epi16(_mm_xor_si128(x2, sign), _mm_xor_si128(x, sign));
+        __m128i hit_y = _mm_cmpgt_epi16(_mm_xor_si128(y2, sign), _mm_xor_si128(y, sign));
+        uint32_t mask = _mm_movemask_epi8(_mm_packs_epi16(_mm_and_si128(hit_x, hit_y), _mm_setzero_si128()));
+        // i is a multiple of 8, so the 8 bits never straddle two words
+        hits[i / 64] |= uint64_t{mask} << (i % 64);
+        count += std::popcount(mask);
+    }
+    return count + clip_scalar(s, in, i, n, out, hits);
+}
+
+__attribute__((target("avx2"))) size_t clip_avx2(Box<uint16_t> s, Columns<uint16_t> in, size_t n, OutColumns<uint16_t> out, uint64_t *hits)
+{
+    const __m256i sign = _mm256_set1_epi16(INT16_MIN);
+    const __m256i sx = _mm256_set1_epi16(static_cast<int16_t>(s.x)), sy = _mm256_set1_epi16(static_cast<int16_t>(s.y));
+    const __m256i sx2 = _mm256_set1_epi16(static_cast<int16_t>(s.x2)), sy2 = _mm256_set1_epi16(static_cast<int16_t>(s.y2));
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i x = _mm256_max_epu16(sx, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in.x + i)));
+        __m256i x2 = _mm256_min_epu16(sx2, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in.x2 + i)));
+        __m256i y = _mm256_max_epu16(sy, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in.y + i)));
+        __m256i y2 = _mm256_min_epu16(sy2, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in.y2 + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.x + i), x);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.x2 + i), x2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.y + i), y);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.y2 + i), y2);
+        __m256i hit_x = _mm256_cmpgt_epi16(_mm256_xor_si256(x2, sign), _mm256_xor_si256(x, sign));
+        __m256i hit_y = _mm256_cmpgt_epi16(_mm256_xor_si256(y2, sign), _mm256_xor_si256(y, sign));
+        __m256i hit = _mm256_and_si256(hit_x, hit_y);
+        // packing works within each 128 bit half: boxes 0-7 land in bytes 0-7 and boxes 8-15 in bytes 16-23
+        uint32_t bytes = _mm256_movemask_epi8(_mm256_packs_epi16(hit, hit));
+        uint32_t mask = (bytes & 0xFF) | (bytes >> 8 & 0xFF00);
+        // i is a multiple of 16, so the 16 bits never straddle two words
+        hits[i / 64] |= uint64_t{mask} << (i % 64);
+        count += std::popcount(mask);
+    }
+    return count + clip_scalar(s, in, i, n, out, hits);
+}
+
+#endif
+
+Isa detect_isa()
+{
+#ifdef NITRO_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return Isa::Avx2;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return Isa::Sse42;
+    }
+#endif
+    return Isa::Scalar;
+}
+
+} // namespace
+
+Isa best_isa()
+{
+    static const Isa isa = detect_isa();
+    return isa;
+}
+
+bool isa_supported(Isa isa)
+{
+    return static_cast<int>(isa) <= static_cast<int>(best_isa());
+}
+
+const char *isa_name(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Avx2:
+        return "avx2";
+    case Isa::Sse42:
+        return "sse4.2";
+    case Isa::Scalar:
+    default:
+        return "scalar";
+    }
+}
+
+template <typename T>
+BasicRectangleSoA<T>::BasicRectangleSoA(const std::vector<BasicRectangle<T>> &rects)
+{
+    reserve(rects.size());
+    for (const BasicRectangle<T> &rect : rects)
+    {
+        push_back(rect);
+    }
+}
+
+template <typename T>
+size_t BasicRectangleSoA<T>::size() const
+{
+    return x.size();
+}
+
+template <typename T>
+void BasicRectangleSoA<T>::reserve(size_t count)
+{
+    x.reserve(count);
+    y.reserve(count);
+    x2.reserve(count);
+    y2.reserve(count);
+}
+
+template <typename T>
+void BasicRectangleSoA<T>::resize(size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    x2.resize(count);
+    y2.resize(count);
+}
+
+template <typename T>
+void BasicRectangleSoA<T>::push_back(const BasicRectangle<T> &rect)
+{
+    x.push_back(rect.m_x);
+    y.push_back(rect.m_y);
+    x2.push_back(rect.x_end());
+    y2.push_back(rect.y_end());
+}
+
+template <typename T>
+BasicRectangle<T> BasicRectangleSoA<T>::get(size_t i) const
+{
+    return BasicRectangle<T>({.x = x[i], .y = y[i], .w = static_cast<T>(x2[i] - x[i]), .h = static_cast<T>(y2[i] - y[i])});
+}
+
+template <typename T>
+size_t intersect_batch(const BasicRectangle<T> &shape, const BasicRectangleSoA<T> &candidates, size_t first, size_t count,
+                       BasicRectangleSoA<T> &out, std::vector<uint64_t> &hits, Isa isa)
+{
+    if (out.size() < count)
+    {
+        out.resize(count);
+    }
+    hits.assign((count + 63) / 64, 0);
+
+    Box<T> s{.x = shape.m_x, .y = shape.m_y, .x2 = shape.x_end(), .y2 = shape.y_end()};
+    Columns<T> in{
+        .x = candidates.x.data() + first,
+        .y = candidates.y.data() + first,
+        .x2 = candidates.x2.data() + first,
+        .y2 = candidates.y2.data() + first,
+    };
+    OutColumns<T> o{.x = out.x.data(), .y = out.y.data(), .x2 = out.x2.data(), .y2 = out.y2.data()};
+
+#ifdef NITRO_X86
+    if constexpr (std::is_same_v<T, uint32_t> || std::is_same_v<T, uint16_t>)
+    {
+        // never run an instruction set the CPU doesn't have, whatever was asked for
+        isa = std::min(isa, best_isa());
+        switch (isa)
+        {
+        case Isa::Avx2:
+            return clip_avx2(s, in, count, o, hits.data());
+        case Isa::Sse42:
+            return clip_sse42(s, in, count, o, hits.data());
+        case Isa::Scalar:
+        default:
+            break;
+        }
+    }
+#endif
+    return clip_scalar(s, in, 0, count, o, hits.data());
+}
+
+#define NITRO_INSTANTIATE_SOA(T)                                                                                          \
+    template class BasicRectangleSoA<T>;                                                                                  \
+    template size_t intersect_batch(const BasicRectangle<T> &shape, const BasicRectangleSoA<T> &candidates, size_t first, \
+                                    size_t count, BasicRectangleSoA<T> &out, std::vector<uint64_t> &hits, Isa isa);
+NITRO_COORDINATE_TYPES(NITRO_INSTANTIATE_SOA)
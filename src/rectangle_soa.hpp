@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "rectangle.hpp"
+
+// Instruction sets intersect_batch can run on
+enum class Isa
+{
+    Scalar,
+    Sse42,
+    Avx2,
+};
+
+// The best instruction set this CPU supports, detected once
+Isa best_isa();
+bool isa_supported(Isa isa);
+const char *isa_name(Isa isa);
+
+/**
+ * Structure-of-arrays rectangle store: one array per coordinate, so consecutive boxes load straight into SIMD lanes.
+ * Rectangles are kept as their [x, x2) and [y, y2) ranges, where x2 = m_x + m_w is computed in T just like BasicRectangle::intersect does.
+ */
+template <typename T>
+class BasicRectangleSoA
+{
+public:
+    std::vector<T> x;
+    std::vector<T> y;
+    std::vector<T> x2;
+    std::vector<T> y2;
+
+    BasicRectangleSoA() = default;
+    explicit BasicRectangleSoA(const std::vector<BasicRectangle<T>> &rects);
+
+    size_t size() const;
+    void reserve(size_t count);
+    void resize(size_t count);
+    void push_back(const BasicRectangle<T> &rect);
+    // Only valid for non empty boxes
+    BasicRectangle<T> get(size_t i) const;
+};
+
+using RectangleSoA = BasicRectangleSoA<uint32_t>;
+
+/**
+ * Clips shape against the `count` boxes of candidates starting at `first`, with the same result as calling shape.intersect on each of them.
+ * Clipped boxes are written to out[0, count) and bit i of hits (64 per word) is set when the i-th clip is not empty.
+ * Boxes of the misses are left with meaningless values. Returns the number of hits.
+ * uint32_t boxes go 8 to an AVX2 register and uint16_t ones 16, the other coordinate types are clipped one box at a time.
+ */
+template <typename T>
+size_t intersect_batch(const BasicRectangle<T> &shape, const BasicRectangleSoA<T> &candidates, size_t first, size_t count,
+                       BasicRectangleSoA<T> &out, std::vector<uint64_t> &hits, Isa isa = best_isa());
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "rtree.hpp"
+
+namespace
+{
+
+// Sort-Tile-Recursive order of items with a box: slices of whole runs by x center, then by y center within each slice
+template <typename T>
+void str_sort(std::vector<T> &items, size_t fanout)
+{
+    auto center_x = [](const T &item)
+    { return uint64_t{item.box.x} + item.box.x2; };
+    auto center_y = [](const T &item)
+    { return uint64_t{item.box.y} + item.box.y2; };
+    std::sort(items.begin(), items.end(), [&](const T &lhs, const T &rhs)
+              { return center_x(lhs) < center_x(rhs); });
+    size_t runs = (items.size() + fanout - 1) / fanout;
+    size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(runs))));
+    size_t slice_size = ((runs + slices - 1) / slices) * fanout;
+    for (size_t start = 0; start < items.size(); start += slice_size)
+    {
+        auto end = items.begin() + std::min(items.size(), start + slice_size);
+        std::sort(items.begin() + start, end, [&](const T &lhs, const T &rhs)
+                  { return center_y(lhs) < center_y(rhs); });
+    }
+}
+
+} // namespace
+
+RTree::RTree(const std::vector<Rectangle> &boxes)
+{
+    for (size_t i = 0; i < boxes.size(); i += 1)
+    {
+        const Rectangle &rect = boxes[i];
+        Box box{.x = rect.m_x, .y = rect.m_y, .x2 = rect.m_x + rect.m_w, .y2 = rect.m_y + rect.m_h};
+        if (box.x < box.x2 && box.y < box.y2)
+        {
+            m_entries.push_back(Entry{.box = box, .index = i});
+        }
+    }
+    if (m_entries.empty())
+    {
+        return;
+    }
+    str_sort(m_entries, FANOUT);
+
+    // Packs consecutive runs of FANOUT items into parent nodes
+    auto pack = [](const auto &items, size_t offset)
+    {
+        std::vector<Node> parents;
+        for (size_t start = 0; start < items.size(); start += FANOUT)
+        {
+            size_t count = std::min(FANOUT, items.size() - start);
+            Node node{.box = items[start].box, .first = offset + start, .count = count};
+            for (size_t k = start + 1; k < start + count; k += 1)
+            {
+                const Box &box = items[k].box;
+                node.box = Box{
+                    .x = std::min(node.box.x, box.x),
+                    .y = std::min(node.box.y, box.y),
+                    .x2 = std::max(node.box.x2, box.x2),
+                    .y2 = std::max(node.box.y2, box.y2),
+                };
+            }
+            parents.push_back(node);
+        }
+        return parents;
+    };
+    std::vector<Node> level = pack(m_entries, 0);
+    m_leaf_count = level.size();
+    while (level.size() > 1)
+    {
+        // Reordering a level is fine as long as it hasn't been stored yet: only its parents will point into it
+        str_sort(level, FANOUT);
+        size_t offset = m_nodes.size();
+        m_nodes.insert(m_nodes.end(), level.begin(), level.end());
+        level = pack(level, offset);
+    }
+    m_nodes.push_back(level.front());
+}
+
+// Depth first descent into the nodes whose box `matches`, calling visit(index) on every matching entry
+template <typename Matches, typename Visit>
+void RTree::search(Matches &&matches, Visit &&visit) const
+{
+    if (m_nodes.empty())
+    {
+        return;
+    }
+    // At most FANOUT - 1 siblings are left pending per level, and 64 bit sizes make for less than 17 levels:
+    // the stack never needs the heap
+    std::array<size_t, FANOUT * 17> stack;
+    size_t pending = 0;
+    stack[pending++] = m_nodes.size() - 1;
+    while (pending > 0)
+    {
+        size_t n = stack[--pending];
+        const Node &node = m_nodes[n];
+        if (!matches(node.box))
+        {
+            continue;
+        }
+        if (n < m_leaf_count)
+        {
+            for (size_t k = node.first; k < node.first + node.count; k += 1)
+            {
+                if (matches(m_entries[k].box))
+                {
+                    visit(m_entries[k].index);
+                }
+            }
+        }
+        else
+        {
+            for (size_t k = node.first; k < node.first + node.count; k += 1)
+            {
+                stack[pending++] = k;
+            }
+        }
+    }
+}
+
+std::vector<size_t> RTree::containing(Point point) const
+{
+    std::vector<size_t> found;
+    search([point](const Box &box)
+           { return box.x <= point.x && point.x < box.x2 && box.y <= point.y && point.y < box.y2; },
+           [&found](size_t index)
+           { found.push_back(index); });
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+std::vector<size_t> RTree::overlapping(const Rectangle &window) const
+{
+    std::vector<size_t> found;
+    // Same arithmetic as Rectangle::intersect
+    Box w{.x = window.m_x, .y = window.m_y, .x2 = window.m_x + window.m_w, .y2 = window.m_y + window.m_h};
+    search([w](const Box &box)
+           { return std::max(w.x, box.x) < std::min(w.x2, box.x2) && std::max(w.y, box.y) < std::min(w.y2, box.y2); },
+           [&found](size_t index)
+           { found.push_back(index); });
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+SpatialIndex::SpatialIndex(std::vector<Rectangle> rects, const IntersectionOptions &options)
+    : m_rects(std::move(rects)), m_rect_tree(m_rects)
+{
+    auto all = Intersection::get_intersections(m_rects, options);
+    m_intersections.assign(all.begin(), all.end());
+    std::vector<Rectangle> shapes;
+    shapes.reserve(m_intersections.size());
+    for (const Intersection &inter : m_intersections)
+    {
+        shapes.push_back(inter.shape());
+    }
+    m_intersection_tree = RTree(shapes);
+}
+
+const std::vector<Rectangle> &SpatialIndex::rectangles() const
+{
+    return m_rects;
+}
+
+// Tree indices are 0 based, ids 1 based
+static std::vector<Id> to_ids(std::vector<size_t> indices)
+{
+    std::vector<Id> ids(indices.begin(), indices.end());
+    for (Id &id : ids)
+    {
+        id += 1;
+    }
+    return ids;
+}
+
+std::vector<const Intersection *> SpatialIndex::intersections(const std::vector<size_t> &indices) const
+{
+    std::vector<const Intersection *> found;
+    found.reserve(indices.size());
+    for (size_t index : indices)
+    {
+        found.push_back(&m_intersections[index]);
+    }
+    return found;
+}
+
+std::vector<Id> SpatialIndex::rectangles_at(Point point) const
+{
+    return to_ids(m_rect_tree.containing(point));
+}
+
+std::vector<Id> SpatialIndex::rectangles_overlapping(const Rectangle &window) const
+{
+    return to_ids(m_rect_tree.overlapping(window));
+}
+
+std::vector<const Intersection *> SpatialIndex::intersections_at(Point point) const
+{
+    return intersections(m_intersection_tree.containing(point));
+}
+
+std::vector<const Intersection *> SpatialIndex::intersections_overlapping(const Rectangle &window) const
+{
+    return intersections(m_intersection_tree.overlapping(window));
+}
+
+std::vector<std::vector<Id>> SpatialIndex::rectangles_at(const std::vector<Point> &points) const
+{
+    std::vector<std::vector<Id>> results;
+    results.reserve(points.size());
+    for (Point point : points)
+    {
+        results.push_back(rectangles_at(point));
+    }
+    return results;
+}
+
+std::vector<std::vector<Id>> SpatialIndex::rectangles_overlapping(const std::vector<Rectangle> &windows) const
+{
+    std::vector<std::vector<Id>> results;
+    results.reserve(windows.size());
+    for (const Rectangle &window : windows)
+    {
+        results.push_back(rectangles_overlapping(window));
+    }
+    return results;
+}
+
+std::vector<std::vector<const Intersection *>> SpatialIndex::intersections_at(const std::vector<Point> &points) const
+{
+    std::vector<std::vector<const Intersection *>> results;
+    results.reserve(points.size());
+    for (Point point : points)
+    {
+        results.push_back(intersections_at(point));
+    }
+    return results;
+}
+
+std::vector<std::vector<const Intersection *>> SpatialIndex::intersections_overlapping(const std::vector<Rectangle> &windows) const
+{
+    std::vector<std::vector<const Intersection *>> results;
+    results.reserve(windows.size());
+    for (const Rectangle &window : windows)
+    {
+        results.push_back(intersections_overlapping(window));
+    }
+    return results;
+}
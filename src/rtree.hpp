@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "rectangle.hpp"
+#include "intersection.hpp"
+
+struct Point
+{
+    uint32_t x;
+    uint32_t y;
+};
+
+/**
+ * Static R-tree over boxes, bulk loaded with Sort-Tile-Recursive packing.
+ *
+ * Every level is tiled into slices by x, then runs of FANOUT boxes by y, so siblings are spatial neighbours and nodes are full.
+ * Nodes live in one flat array, leaves first and the root last, with the children of a node stored contiguously:
+ * a query only follows indices, never pointers.
+ * Boxes are half-open like everywhere else: a box contains (x, y) when x <= px < x2, and overlaps a window only with a positive area.
+ */
+class RTree
+{
+    static constexpr size_t FANOUT = 16;
+
+    struct Box
+    {
+        uint32_t x, y, x2, y2;
+    };
+
+    struct Entry
+    {
+        Box box;
+        // index of the box in the vector given to the constructor
+        size_t index;
+    };
+
+    struct Node
+    {
+        Box box;
+        // leaves: their first entry, other nodes: their first child
+        size_t first;
+        size_t count;
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<Node> m_nodes;
+    // nodes [0, m_leaf_count) are leaves
+    size_t m_leaf_count = 0;
+
+    template <typename Matches, typename Visit>
+    void search(Matches &&matches, Visit &&visit) const;
+
+public:
+    RTree() = default;
+    // Boxes that are empty or wrap around uint32_t are left out, they can't contain or overlap anything (see Rectangle::intersect)
+    explicit RTree(const std::vector<Rectangle> &boxes);
+
+    // Indices of the boxes containing the point, in increasing order
+    std::vector<size_t> containing(Point point) const;
+    // Indices of the boxes overlapping the window, in increasing order
+    std::vector<size_t> overlapping(const Rectangle &window) const;
+};
+
+/**
+ * Point and window queries over a fixed set of rectangles and all of their intersections.
+ * Both are indexed by an RTree once, so each query only costs a tree descent instead of a get_intersections call.
+ * The intersections are enumerated when the index is built, which is as expensive as get_intersections itself.
+ */
+class SpatialIndex
+{
+    std::vector<Rectangle> m_rects;
+    RTree m_rect_tree;
+    // in std::set<Intersection> order
+    std::vector<Intersection> m_intersections;
+    RTree m_intersection_tree;
+
+    std::vector<const Intersection *> intersections(const std::vector<size_t> &indices) const;
+
+public:
+    explicit SpatialIndex(std::vector<Rectangle> rects, const IntersectionOptions &options = {});
+
+    const std::vector<Rectangle> &rectangles() const;
+
+    // Ids of the rectangles containing the point / overlapping the window, in increasing order
+    std::vector<Id> rectangles_at(Point point) const;
+    std::vector<Id> rectangles_overlapping(const Rectangle &window) const;
+    // Intersections whose shape contains the point / overlaps the window, in std::set<Intersection> order.
+    // The pointers stay valid as long as the index
+    std::vector<const Intersection *> intersections_at(Point point) const;
+    std::vector<const Intersection *> intersections_overlapping(const Rectangle &window) const;
+
+    // Batch versions: one result per query, in query order
+    std::vector<std::vector<Id>> rectangles_at(const std::vector<Point> &points) const;
+    std::vector<std::vector<Id>> rectangles_overlapping(const std::vector<Rectangle> &windows) const;
+    std::vector<std::vector<const Intersection *>> intersections_at(const std::vector<Point> &points) const;
+    std::vector<std::vector<const Intersection *>> intersections_overlapping(const std::vector<Rectangle> &windows) const;
+};
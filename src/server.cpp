@@ -0,0 +1,426 @@
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hpp"
+
+namespace
+{
+
+// Output stream buffer appending to a string that is kept, with its capacity, from one request to the next
+class StringBuffer : public std::streambuf
+{
+public:
+    std::string text;
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (c != traits_type::eof())
+        {
+            text.push_back(traits_type::to_char_type(c));
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize count) override
+    {
+        text.append(s, static_cast<size_t>(count));
+        return count;
+    }
+};
+
+// A client connection. Its requests are read by the polling thread and answered by the workers
+struct Connection
+{
+    int fd;
+    // Only touched by the polling thread: what was read past the last complete line, and how much of it has no newline
+    std::string partial;
+    size_t scanned = 0;
+    // the line being read is longer than max_request, and dropped up to its newline
+    bool dropping = false;
+
+    // Guarded by the server's mutex
+    // complete lines waiting for an answer, in order. std::nullopt for one that was too long
+    std::deque<std::optional<std::string>> lines;
+    size_t queued_bytes = 0;
+    // a worker is answering lines.front(), or it is waiting for one
+    bool busy = false;
+    // the client won't send anything more
+    bool ended = false;
+    // a response couldn't be sent, the client is gone
+    bool broken = false;
+    // responses from output[sent] on are waiting for the client to read them, only the polling thread sends them
+    std::string output;
+    size_t sent = 0;
+
+    explicit Connection(int fd) : fd(fd) {}
+
+    size_t unsent() const
+    {
+        return output.size() - sent;
+    }
+
+    // Nothing more is read, answered or sent
+    void set_broken()
+    {
+        broken = true;
+        lines.clear();
+        queued_bytes = 0;
+        output.clear();
+        sent = 0;
+    }
+};
+
+// Sends as much of the output of connection as its socket takes without blocking. Returns false if the client is gone
+bool send_output(Connection &connection)
+{
+    while (connection.unsent() > 0)
+    {
+        // MSG_NOSIGNAL: a client hanging up must not kill the server with SIGPIPE
+        ssize_t result = send(connection.fd, connection.output.data() + connection.sent, connection.unsent(), MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (result <= 0)
+        {
+            return false;
+        }
+        connection.sent += static_cast<size_t>(result);
+    }
+    // what was sent is only moved out once it is most of the buffer, so each byte is moved at most once on average
+    if (connection.sent == connection.output.size() || connection.sent > connection.output.size() / 2)
+    {
+        connection.output.erase(0, connection.sent);
+        connection.sent = 0;
+    }
+    return true;
+}
+
+// Appends the complete lines of what was just read to lines, skipping empty ones
+void split_lines(Connection &connection, const char *data, size_t count, size_t max_request, std::vector<std::optional<std::string>> &lines)
+{
+    std::string &partial = connection.partial;
+    partial.append(data, count);
+    size_t start = 0;
+    // the bytes scanned by earlier reads hold no newline, a long line is only ever scanned once
+    for (size_t end = partial.find('\n', connection.scanned); end != std::string::npos; end = partial.find('\n', start))
+    {
+        if (connection.dropping || end - start > max_request)
+        {
+            lines.push_back(std::nullopt);
+            connection.dropping = false;
+        }
+        else if (end > start)
+        {
+            lines.push_back(partial.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    partial.erase(0, start);
+    if (partial.size() > max_request)
+    {
+        connection.dropping = true;
+        partial.clear();
+    }
+    connection.scanned = partial.size();
+}
+
+// Appends the last line of a client that won't send anything more, if it didn't end it with a newline
+void end_lines(Connection &connection, std::vector<std::optional<std::string>> &lines)
+{
+    if (connection.dropping)
+    {
+        lines.push_back(std::nullopt);
+        connection.dropping = false;
+    }
+    else if (!connection.partial.empty())
+    {
+        lines.push_back(std::move(connection.partial));
+    }
+    connection.partial.clear();
+    connection.scanned = 0;
+}
+
+} // namespace
+
+Server::Server(int fd, std::string path) : m_fd(fd), m_path(std::move(path)) {}
+
+std::optional<Server> Server::listen(const std::string &path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+    {
+        return std::nullopt;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // Only ever remove a socket, never a regular file that happens to have that name
+    struct stat status;
+    if (stat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+    {
+        unlink(path.c_str());
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return std::nullopt;
+    }
+    if (bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 || ::listen(fd, 64) != 0)
+    {
+        close(fd);
+        return std::nullopt;
+    }
+    return Server(fd, path);
+}
+
+Server::Server(Server &&other) noexcept : m_fd(other.m_fd), m_path(std::move(other.m_path))
+{
+    other.m_fd = -1;
+}
+
+Server::~Server()
+{
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        unlink(m_path.c_str());
+    }
+}
+
+void Server::run(const Handler &handler, unsigned workers, size_t max_request)
+{
+    std::mutex mutex;
+    std::condition_variable ready_changed;
+    // connections whose first line waits for a worker
+    std::deque<Connection *> ready;
+    bool done = false;
+    // the workers write a byte to wake[1] whenever a connection they answered may need the polling thread
+    int wake[2];
+    if (pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        return;
+    }
+
+    // Hands the next line of connection to the workers, unless one is answering it already or its client is behind on
+    // reading its responses. Called with mutex held
+    auto schedule = [&](Connection &connection)
+    {
+        if (!connection.busy && !connection.broken && !connection.lines.empty() && connection.unsent() < max_request)
+        {
+            connection.busy = true;
+            // behind the other connections' requests, so one client can't take a worker for itself
+            ready.push_back(&connection);
+            ready_changed.notify_one();
+        }
+    };
+
+    auto worker = [&]()
+    {
+        StringBuffer response;
+        std::ostream os(&response);
+        while (true)
+        {
+            Connection *connection;
+            std::optional<std::string> line;
+            {
+                std::unique_lock lock(mutex);
+                ready_changed.wait(lock, [&]()
+                                   { return done || !ready.empty(); });
+                if (ready.empty())
+                {
+                    return;
+                }
+                connection = ready.front();
+                ready.pop_front();
+                line = std::move(connection->lines.front());
+                connection->lines.pop_front();
+                connection->queued_bytes -= line.has_value() ? line->size() : 0;
+            }
+            response.text.clear();
+            os.clear();
+            if (line.has_value())
+            {
+                // one request failing, even for lack of memory, must not take the other clients down with it
+                try
+                {
+                    handler(*line, os);
+                }
+                catch (const std::exception &error)
+                {
+                    response.text.clear();
+                    os.clear();
+                    os << "Error: Could not answer the request: " << error.what();
+                }
+            }
+            else
+            {
+                os << "Improper input: request longer than " << max_request << " bytes";
+            }
+            os.flush();
+            if (!response.text.ends_with('\n'))
+            {
+                response.text.push_back('\n');
+            }
+            response.text.push_back('\n');
+            // sent by the polling thread, so a client that doesn't read can't hold a worker
+            {
+                std::lock_guard lock(mutex);
+                if (!connection->broken)
+                {
+                    connection->output.append(response.text);
+                }
+                connection->busy = false;
+                schedule(*connection);
+            }
+            char byte = 0;
+            [[maybe_unused]] ssize_t ignored = write(wake[1], &byte, 1);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < std::max(workers, 1u); i += 1)
+    {
+        threads.emplace_back(worker);
+    }
+
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<pollfd> polled;
+    std::vector<std::optional<std::string>> lines;
+    char chunk[1 << 16];
+    bool accepting = true;
+    while (true)
+    {
+        polled.clear();
+        polled.push_back(pollfd{.fd = wake[0], .events = POLLIN, .revents = 0});
+        polled.push_back(pollfd{.fd = accepting ? m_fd : -1, .events = POLLIN, .revents = 0});
+        {
+            std::lock_guard lock(mutex);
+            std::erase_if(connections, [](const std::unique_ptr<Connection> &connection)
+                          {
+                              bool finished = !connection->busy && (connection->broken || (connection->ended && connection->lines.empty() && connection->unsent() == 0));
+                              if (finished)
+                              {
+                                  close(connection->fd);
+                              }
+                              return finished; });
+            for (const auto &connection : connections)
+            {
+                // not read while its requests or the responses its client hasn't read pile up
+                bool reading = !connection->ended && !connection->broken && connection->queued_bytes < max_request && connection->unsent() < max_request;
+                bool writing = !connection->broken && connection->unsent() > 0;
+                short events = static_cast<short>((reading ? POLLIN : 0) | (writing ? POLLOUT : 0));
+                // a negative fd is skipped by poll
+                polled.push_back(pollfd{.fd = events != 0 ? connection->fd : -1, .events = events, .revents = 0});
+            }
+        }
+        if (!accepting && connections.empty())
+        {
+            break;
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0)
+        {
+            continue;
+        }
+        if (polled[0].revents != 0)
+        {
+            while (read(wake[0], chunk, sizeof(chunk)) > 0)
+            {
+            }
+        }
+        // new connections are only polled from the next round on, polled[i + 2] is connections[i]
+        size_t polled_connections = connections.size();
+        if (polled[1].revents != 0)
+        {
+            int client = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (client >= 0)
+            {
+                connections.push_back(std::make_unique<Connection>(client));
+            }
+            else if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN)
+            {
+                // stop() shut the socket down
+                accepting = false;
+            }
+        }
+        for (size_t i = 0; i < polled_connections; i += 1)
+        {
+            const pollfd &entry = polled[i + 2];
+            Connection &connection = *connections[i];
+            if ((entry.events & POLLOUT) && (entry.revents & (POLLOUT | POLLERR | POLLHUP)))
+            {
+                std::lock_guard lock(mutex);
+                if (!send_output(connection))
+                {
+                    connection.set_broken();
+                }
+                // back under the limit, its waiting requests can be answered again
+                schedule(connection);
+            }
+            // only this thread breaks connections off, so broken can be read without the lock
+            if (connection.broken || !(entry.events & POLLIN) || !(entry.revents & (POLLIN | POLLERR | POLLHUP)))
+            {
+                continue;
+            }
+            ssize_t count = read(connection.fd, chunk, sizeof(chunk));
+            if (count < 0 && (errno == EINTR || errno == EAGAIN))
+            {
+                continue;
+            }
+            lines.clear();
+            if (count > 0)
+            {
+                split_lines(connection, chunk, static_cast<size_t>(count), max_request, lines);
+            }
+            else
+            {
+                end_lines(connection, lines);
+            }
+            std::lock_guard lock(mutex);
+            connection.ended = count <= 0;
+            for (auto &line : lines)
+            {
+                connection.queued_bytes += line.has_value() ? line->size() : 0;
+                connection.lines.push_back(std::move(line));
+            }
+            schedule(connection);
+        }
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        done = true;
+    }
+    ready_changed.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    close(wake[0]);
+    close(wake[1]);
+}
+
+void Server::stop()
+{
+    // wakes every thread blocked in accept, without closing the descriptor they are using
+    shutdown(m_fd, SHUT_RDWR);
+}
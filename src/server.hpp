@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * Line based request/response server on a Unix domain socket.
+ *
+ * Every line a client sends is one request. Its response is whatever the handler writes, followed by a newline if it
+ * doesn't end with one already, then an empty line, so clients can tell where a response ends without knowing its format.
+ * Clients may send any number of requests on one connection, they are answered in order. The last one may go without
+ * its newline if the client shuts its side of the connection down after it.
+ * A handler that throws a std::exception gets an error response in place of what it wrote, and the server keeps going.
+ *
+ * The thread that calls run() waits on every connection at once and hands each complete line to a fixed pool of workers,
+ * so threads and their buffers stay warm across requests, and idle clients don't hold any of them. A connection has at
+ * most one request being answered at a time, which keeps its responses in order, and stops being read while the requests
+ * it has queued add up to max_request bytes. A line longer than max_request is dropped as it arrives and answered with an
+ * error, so no client can make the server buffer more than that.
+ *
+ * Responses are queued on their connection and sent by the polling thread as the client reads them, so a client that
+ * stops reading doesn't hold a worker either. Once its unread responses add up to max_request bytes, its queued requests
+ * wait and it stops being read until it catches up.
+ */
+class Server
+{
+    int m_fd = -1;
+    std::string m_path;
+
+    Server(int fd, std::string path);
+
+public:
+    using Handler = std::function<void(std::string_view request, std::ostream &response)>;
+
+    // Binds and listens on path, replacing a stale socket left there. std::nullopt if that fails
+    static std::optional<Server> listen(const std::string &path);
+
+    Server(Server &&other) noexcept;
+    Server &operator=(Server &&other) = delete;
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+    // Closes the socket and removes its file
+    ~Server();
+
+    // Default longest request line, in bytes: a JSON document of about a million rectangles
+    static constexpr size_t DEFAULT_MAX_REQUEST = size_t{64} << 20;
+
+    // Serves clients, answering their requests on `workers` threads, until stop() is called
+    void run(const Handler &handler, unsigned workers, size_t max_request = DEFAULT_MAX_REQUEST);
+    // Stops accepting clients: run() returns once the current clients have hung up. Can be called from any thread
+    void stop();
+};
@@ -0,0 +1,75 @@
+#include <bit>
+#include <cassert>
+#include "small_search.hpp"
+#include "stats.hpp"
+
+template <typename T, size_t N>
+SmallSearch<T, N>::SmallSearch(const std::vector<Shape> &inputs, const IntersectionOptions &options)
+    : m_inputs(inputs), m_min_degree(options.min_degree), m_max_degree(options.max_degree)
+{
+    assert(inputs.size() <= N);
+    for (size_t i = 0; i < inputs.size(); i += 1)
+    {
+        for (size_t j = i + 1; j < inputs.size(); j += 1)
+        {
+            NITRO_COUNT(pairs_tested, 1);
+            if (inputs[i].intersect(inputs[j]).has_value())
+            {
+                NITRO_COUNT(pair_hits, 1);
+                m_later[i] |= uint64_t{1} << j;
+            }
+        }
+    }
+}
+
+template <typename T, size_t N>
+std::optional<BasicIntersection<T>> SmallSearch<T, N>::next()
+{
+    while (true)
+    {
+        if (m_depth == 0)
+        {
+            // the next branch grows from the next rectangle that overlaps a greater one
+            while (m_next_root < m_inputs.size() && m_later[m_next_root] == 0)
+            {
+                m_next_root += 1;
+            }
+            if (m_next_root == m_inputs.size())
+            {
+                return std::nullopt;
+            }
+            size_t root = m_next_root;
+            m_next_root += 1;
+            m_stack[0] = Frame{.shape = m_inputs[root], .ids = uint64_t{1} << root, .candidates = m_max_degree >= 2 ? m_later[root] : 0};
+            m_depth = 1;
+        }
+        Frame &top = m_stack[m_depth - 1];
+        if (top.candidates == 0)
+        {
+            m_depth -= 1;
+            continue;
+        }
+        // lowest id first: preorder then visits id sets in lexicographic order
+        size_t j = std::countr_zero(top.candidates);
+        top.candidates &= top.candidates - 1;
+        NITRO_COUNT(extension_attempts, 1);
+        size_t degree = m_depth + 1;
+        // what is left of top.candidates are its extensions past j, the ones j overlaps extend the new set too
+        m_stack[m_depth] = Frame{
+            .shape = *top.shape.intersect(m_inputs[j]),
+            .ids = top.ids | uint64_t{1} << j,
+            .candidates = degree < m_max_degree ? top.candidates & m_later[j] : 0,
+        };
+        m_depth += 1;
+        NITRO_HIGH_WATER(queue_high_water, m_depth);
+        if (degree >= m_min_degree)
+        {
+            NITRO_COUNT(intersections_emitted, 1);
+            return Inter(m_stack[m_depth - 1].shape, IdSet::from_bits(m_stack[m_depth - 1].ids));
+        }
+    }
+}
+
+#define NITRO_INSTANTIATE_SMALL_SEARCH_SIZE(T, N) template class SmallSearch<T, N>;
+#define NITRO_INSTANTIATE_SMALL_SEARCH(T) NITRO_SMALL_SEARCH_SIZES(NITRO_INSTANTIATE_SMALL_SEARCH_SIZE, T)
+NITRO_COORDINATE_TYPES(NITRO_INSTANTIATE_SMALL_SEARCH)
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <vector>
+#include "intersection.hpp"
+
+// Largest input SmallSearch takes: one bit per id in a uint64_t
+constexpr size_t SMALL_SEARCH_MAX_INPUTS = 64;
+
+// The capacities SmallSearch and BasicIntersection::get_intersections<N> are instantiated for, with coordinates T,
+// as X(T, N) X(T, N) ...
+#define NITRO_SMALL_SEARCH_SIZES(X, T) X(T, 16) X(T, 32) X(T, 64)
+
+/**
+ * The canonical enumeration (see CanonicalSearch) for inputs of at most N <= 64 rectangles, the size main is usually given.
+ *
+ * Every id fits in a bit of a uint64_t, so each rectangle's overlaps are computed once up front as a mask of the greater ids
+ * it overlaps. Rectangles have the Helly property (see get_maximal_intersections): a set of them intersects as soon as they
+ * overlap pairwise. The ids that extend an intersection are then the common bits of the masks of all its ids, one AND per
+ * extension, and every one of them does extend it: no clip is ever thrown away.
+ *
+ * The walk is depth first, one frame per degree in a std::array, so the whole search lives in the object and allocates nothing
+ * but the id sets of the copies it yields, which stay inline. Like IntersectionStream, intersections come out in
+ * std::set<BasicIntersection> order, and the inputs must outlive the search.
+ */
+template <typename T, size_t N>
+class SmallSearch
+{
+    static_assert(N <= SMALL_SEARCH_MAX_INPUTS);
+
+    using Shape = BasicRectangle<T>;
+    using Inter = BasicIntersection<T>;
+
+    struct Frame
+    {
+        // a placeholder until the frame is first pushed, rectangles can't be empty
+        Shape shape{BasicRectCoors<T>{.x = 0, .y = 0, .w = 1, .h = 1}};
+        // bit i for id i + 1
+        uint64_t ids = 0;
+        // the greater ids that extend it and have not been walked yet
+        uint64_t candidates = 0;
+    };
+
+    const std::vector<Shape> &m_inputs;
+    size_t m_min_degree;
+    size_t m_max_degree;
+    // bit j of m_later[i] is set when i < j and rectangles i + 1 and j + 1 overlap
+    std::array<uint64_t, N> m_later{};
+    // m_stack[d] holds an intersection of d + 1 rectangles, the first one a single rectangle the branch grows from
+    std::array<Frame, N> m_stack;
+    size_t m_depth = 0;
+    size_t m_next_root = 0;
+
+public:
+    // inputs.size() must be at most N. Uses the degree bounds of options, the overlaps are always tested pair by pair
+    SmallSearch(const std::vector<Shape> &inputs, const IntersectionOptions &options = {});
+
+    // The next intersection, std::nullopt once they have all been yielded
+    std::optional<Inter> next();
+};
+
+/**
+ * The mask based walk for inputs of at most N rectangles. Its state is a few std::arrays of N entries,
+ * which is why there is one per capacity rather than one for 64: the smaller ones touch less memory.
+ * Id sets come out in std::set<BasicIntersection> order, so every insertion goes straight to the end of the result.
+ */
+template <typename T>
+template <size_t N>
+std::set<BasicIntersection<T>> BasicIntersection<T>::get_intersections(const std::vector<Shape> &inputs, const IntersectionOptions &options)
+{
+    std::set<BasicIntersection> all_intersections;
+    SmallSearch<T, N> search(inputs, options);
+    for (auto inter = search.next(); inter.has_value(); inter = search.next())
+    {
+        all_intersections.insert(all_intersections.end(), std::move(*inter));
+    }
+    return all_intersections;
+}
@@ -0,0 +1,181 @@
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include "stats.hpp"
+
+namespace
+{
+
+std::mutex g_totals_mutex;
+Counters g_totals;
+
+// Updated by operator new from any thread, even before main and after thread locals are gone
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_bytes_allocated{0};
+
+} // namespace
+
+#ifdef NITRO_STATS
+
+// The replaced operators keep the usual semantics, they only count on the way to malloc
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+    // malloc(0) may return nullptr, but new must return a unique pointer
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    if (void *p = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+#endif
+
+void Counters::add(const Counters &other)
+{
+    pairs_tested += other.pairs_tested;
+    pair_hits += other.pair_hits;
+    extension_attempts += other.extension_attempts;
+    dedup_hits += other.dedup_hits;
+    dedup_misses += other.dedup_misses;
+    queue_high_water = std::max(queue_high_water, other.queue_high_water);
+    intersections_emitted += other.intersections_emitted;
+    allocations += other.allocations;
+    bytes_allocated += other.bytes_allocated;
+}
+
+Stats::ThreadCounters::~ThreadCounters()
+{
+    std::lock_guard lock(g_totals_mutex);
+    g_totals.add(*this);
+}
+
+Counters Stats::totals()
+{
+    Counters totals;
+    {
+        std::lock_guard lock(g_totals_mutex);
+        totals = g_totals;
+    }
+    totals.add(local());
+    totals.allocations = g_allocations.load(std::memory_order_relaxed);
+    totals.bytes_allocated = g_bytes_allocated.load(std::memory_order_relaxed);
+    return totals;
+}
+
+void Stats::reset()
+{
+    {
+        std::lock_guard lock(g_totals_mutex);
+        g_totals = Counters{};
+    }
+    local() = Counters{};
+    g_allocations.store(0, std::memory_order_relaxed);
+    g_bytes_allocated.store(0, std::memory_order_relaxed);
+}
+
+const char *phase_name(Phase phase)
+{
+    switch (phase)
+    {
+    case Phase::Read:
+        return "read";
+    case Phase::Parse:
+        return "parse";
+    case Phase::Validate:
+        return "validate";
+    case Phase::Compute:
+        return "compute";
+    case Phase::Print:
+    default:
+        return "print";
+    }
+}
+
+PhaseTimer::Scope::Scope(PhaseTimer &timer, Phase phase)
+    : m_timer(timer), m_phase(phase), m_start(timer.m_enabled ? Clock::now() : Clock::time_point{}) {}
+
+PhaseTimer::Scope::~Scope()
+{
+    if (m_timer.m_enabled)
+    {
+        m_timer.m_spent[static_cast<size_t>(m_phase)] += Clock::now() - m_start;
+    }
+}
+
+PhaseTimer::PhaseTimer(bool enabled) : m_enabled(enabled) {}
+
+bool PhaseTimer::enabled() const
+{
+    return m_enabled;
+}
+
+PhaseTimer::Scope PhaseTimer::time(Phase phase)
+{
+    return Scope(*this, phase);
+}
+
+double PhaseTimer::ms(Phase phase) const
+{
+    return std::chrono::duration<double, std::milli>(m_spent[static_cast<size_t>(phase)]).count();
+}
+
+void write_stats(std::ostream &os, const PhaseTimer &timer, const Counters &counters)
+{
+    os << "{\"phases_ms\":{";
+    for (Phase phase : {Phase::Read, Phase::Parse, Phase::Validate, Phase::Compute, Phase::Print})
+    {
+        os << (phase == Phase::Read ? "\"" : ",\"") << phase_name(phase) << "\":" << timer.ms(phase);
+    }
+    os << "},\"counters\":";
+    if (!Stats::ENABLED)
+    {
+        os << "null}\n";
+        return;
+    }
+    os << "{\"pairs_tested\":" << counters.pairs_tested
+       << ",\"pair_hits\":" << counters.pair_hits
+       << ",\"extension_attempts\":" << counters.extension_attempts
+       << ",\"dedup_hits\":" << counters.dedup_hits
+       << ",\"dedup_misses\":" << counters.dedup_misses
+       << ",\"queue_high_water\":" << counters.queue_high_water
+       << ",\"intersections_emitted\":" << counters.intersections_emitted
+       << ",\"allocations\":" << counters.allocations
+       << ",\"bytes_allocated\":" << counters.bytes_allocated << "}}\n";
+}
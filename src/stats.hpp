@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/**
+ * Hot path counters of the engines, reported by --stats.
+ *
+ * They only exist in builds with NITRO_STATS defined (make STATS=1): otherwise NITRO_COUNT and NITRO_HIGH_WATER expand to nothing
+ * and the engines pay nothing for them.
+ * Every thread counts into its own Counters and adds them to the totals when it exits, so counting never contends between threads.
+ * Allocations are the exception: operator new is replaced to count them straight into process wide atomics.
+ */
+struct Counters
+{
+    // Candidate pairs the broad phase tested, and how many of them overlap
+    uint64_t pairs_tested = 0;
+    uint64_t pair_hits = 0;
+    // Rectangles an intersection was clipped against to extend it
+    uint64_t extension_attempts = 0;
+    // Extensions the Exhaustive enumeration threw away as already found, and the ones it kept
+    uint64_t dedup_hits = 0;
+    uint64_t dedup_misses = 0;
+    // Largest number of intersections waiting to be extended at once, in any single queue or stack
+    uint64_t queue_high_water = 0;
+    // Intersections the engines returned
+    uint64_t intersections_emitted = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes_allocated = 0;
+
+    void add(const Counters &other);
+    bool operator==(const Counters &other) const = default;
+};
+
+class Stats
+{
+    // Adds itself to the totals when its thread exits
+    struct ThreadCounters : Counters
+    {
+        ~ThreadCounters();
+    };
+
+public:
+#ifdef NITRO_STATS
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    // The counters of the calling thread
+    static Counters &local()
+    {
+        thread_local ThreadCounters counters;
+        return counters;
+    }
+
+    // Counts of the threads that have exited, plus the calling thread's. Threads still running are not included
+    static Counters totals();
+    // Zeroes the totals and the calling thread's counters
+    static void reset();
+};
+
+#ifdef NITRO_STATS
+#define NITRO_COUNT(counter, n) (Stats::local().counter += (n))
+#define NITRO_HIGH_WATER(counter, value) (Stats::local().counter = std::max<uint64_t>(Stats::local().counter, (value)))
+#else
+#define NITRO_COUNT(counter, n) ((void)0)
+#define NITRO_HIGH_WATER(counter, value) ((void)0)
+#endif
+
+// Phases of main timed by --stats
+enum class Phase
+{
+    Read,
+    Parse,
+    Validate,
+    Compute,
+    Print,
+};
+
+const char *phase_name(Phase phase);
+
+/**
+ * Wall clock time spent in each Phase. A phase can be entered any number of times, its time adds up.
+ * A disabled timer never reads the clock.
+ */
+class PhaseTimer
+{
+    static constexpr size_t PHASE_COUNT = 5;
+    using Clock = std::chrono::steady_clock;
+
+    bool m_enabled;
+    Clock::duration m_spent[PHASE_COUNT] = {};
+
+public:
+    // Adds the time from its construction to its destruction to a phase
+    class Scope
+    {
+        PhaseTimer &m_timer;
+        Phase m_phase;
+        Clock::time_point m_start;
+
+    public:
+        Scope(PhaseTimer &timer, Phase phase);
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+        ~Scope();
+    };
+
+    explicit PhaseTimer(bool enabled);
+
+    bool enabled() const;
+    [[nodiscard]] Scope time(Phase phase);
+    double ms(Phase phase) const;
+};
+
+// {"phases_ms":{"read":...},"counters":{"pairs_tested":...}} on a single line.
+// "counters" is null in builds without NITRO_STATS
+void write_stats(std::ostream &os, const PhaseTimer &timer, const Counters &counters);
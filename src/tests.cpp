@@ -5,9 +5,33 @@
 #include <sstream>
 #include <string>
 #include <cassert>
+#include <random>
+#include <algorithm>
+#include <iterator>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <memory_resource>
+#include <new>
+#include <variant>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "rectangle.hpp"
 #include "intersection.hpp"
+#include "input.hpp"
+#include "intersection_stream.hpp"
+#include "intersection_tree.hpp"
+#include "small_search.hpp"
+#include "duplicate_classes.hpp"
+#include "output.hpp"
+#include "coverage.hpp"
+#include "rtree.hpp"
+#include "intersection_index.hpp"
+#include "server.hpp"
+#include "stats.hpp"
 
 using std::vector, std::string;
 
@@ -316,9 +340,25 @@ public:
         run_and_reverse(fully_contained(), "Fully contained");
         run_and_reverse(fully_overlapping(), "Fully overlapping");
         run_and_reverse(partially_contained_overflowing(), "Partially contained and overflowing");
+        run_signed_ends();
         std::cout << "\n";
     }
 
+    // int32_t ends past INT32_MAX wrap around like the unsigned ones, and negative coordinates overlap as usual
+    static void run_signed_ends()
+    {
+        using Rectangle32 = BasicRectangle<int32_t>;
+        Rectangle32 wrapping({.x = INT32_MAX - 5, .y = 0, .w = 10, .h = 10});
+        Rectangle32 inside({.x = INT32_MAX - 3, .y = 2, .w = 2, .h = 2});
+        Rectangle32 negative({.x = -10, .y = -10, .w = 15, .h = 15});
+        Rectangle32 origin({.x = 0, .y = 0, .w = 10, .h = 10});
+        auto overlap = negative.intersect(origin);
+        bool passed = wrapping.x_end() == INT32_MIN + 4 && !wrapping.intersect(inside).has_value() && !inside.intersect(wrapping).has_value() &&
+                      overlap.has_value() && *overlap == Rectangle32({.x = 0, .y = 0, .w = 5, .h = 5});
+        print_test_case(passed, "int32_t ends wrap around, negative coordinates overlap", []()
+                        { return string("\t unexpected int32_t intersection\n"); });
+    }
+
     static void run_and_reverse(const TestCase &test, string name)
     {
         auto actual = test.inputs.first.intersect(test.inputs.second);
@@ -582,8 +622,1734 @@ public:
     }
 };
 
+class InputTest
+{
+    struct Expected
+    {
+        ParsedInput::Status status;
+        vector<Rectangle> rects;
+        size_t rect_count;
+        vector<string> invalid_rects;
+    };
+    using TestCase = ITestCase<std::pair<string, size_t>, Expected>;
+
+    static TestCase valid_rects()
+    {
+        return TestCase{
+            .inputs = {R"({"rects": [{"x": 1, "y": 2, "w": 3, "h": 4}, {"h": 8, "w": 7, "y": 6, "x": 5}]})", 10},
+            .expected = {
+                .status = ParsedInput::Status::Ok,
+                .rects = {Rectangle({.x = 1, .y = 2, .w = 3, .h = 4}), Rectangle({.x = 5, .y = 6, .w = 7, .h = 8})},
+                .rect_count = 2,
+                .invalid_rects = {}}};
+    }
+
+    // every invalid element is reported, quoted the way boost::json::serialize prints it
+    static TestCase invalid_rects()
+    {
+        return TestCase{
+            .inputs = {R"({"other": [1, {"x": 1}], "rects": [
+                {"x": 1, "y": 2, "h": 4},
+                {"x": 1, "y": 2, "w": 3, "h": 4, "z": 5},
+                {"x": -1, "y": 2, "w": 3, "h": 4},
+                {"x": 4294967296, "y": 2, "w": 3, "h": 4},
+                {"x": "1", "y": 2, "w": 3, "h": 4},
+                {"x": [1], "y": {"a\n": null}, "w": true, "h": 4},
+                {"x": 1, "y": 2, "w": 0, "h": 4},
+                {"x": 1, "y": 2, "w": 3, "h": 0},
+                7,
+                {"x": 1, "y": 2, "w": 3, "h": 4}
+            ]})",
+                       10},
+            .expected = {
+                .status = ParsedInput::Status::InvalidRects,
+                .rects = {Rectangle({.x = 1, .y = 2, .w = 3, .h = 4})},
+                .rect_count = 10,
+                .invalid_rects = {
+                    R"({"x":1,"y":2,"h":4})",
+                    R"({"x":1,"y":2,"w":3,"h":4,"z":5})",
+                    R"({"x":-1,"y":2,"w":3,"h":4})",
+                    R"({"x":4294967296,"y":2,"w":3,"h":4})",
+                    R"({"x":"1","y":2,"w":3,"h":4})",
+                    R"({"x":[1],"y":{"a\n":null},"w":true,"h":4})",
+                    R"({"x":1,"y":2,"w":0,"h":4})",
+                    R"({"x":1,"y":2,"w":3,"h":0})",
+                    "7",
+                }}};
+    }
+
+    // elements past the limit are counted, but neither kept nor validated
+    static TestCase past_limit()
+    {
+        return TestCase{
+            .inputs = {R"({"rects": [{"x": 1, "y": 2, "w": 3, "h": 4}, {"x": 1}, {"x": 1}]})", 1},
+            .expected = {
+                .status = ParsedInput::Status::Ok,
+                .rects = {Rectangle({.x = 1, .y = 2, .w = 3, .h = 4})},
+                .rect_count = 3,
+                .invalid_rects = {}}};
+    }
+
+    static TestCase syntax_error()
+    {
+        return TestCase{
+            .inputs = {R"({"rects": [{"x": 1, "y": 2, "w": 3, "h": 4}})", 10},
+            .expected = {.status = ParsedInput::Status::SyntaxError, .rects = {}, .rect_count = 0, .invalid_rects = {}}};
+    }
+
+    static TestCase not_an_object()
+    {
+        return TestCase{
+            .inputs = {R"([{"x": 1, "y": 2, "w": 3, "h": 4}])", 10},
+            .expected = {.status = ParsedInput::Status::NotAnObject, .rects = {}, .rect_count = 0, .invalid_rects = {}}};
+    }
+
+    static TestCase rects_not_an_array()
+    {
+        return TestCase{
+            .inputs = {R"({"rects": {"x": 1, "y": 2, "w": 3, "h": 4}})", 10},
+            .expected = {.status = ParsedInput::Status::MissingRects, .rects = {}, .rect_count = 0, .invalid_rects = {}}};
+    }
+
+public:
+    static void runAll()
+    {
+        std::cout << "--> Input Tests";
+        run(valid_rects(), "Valid rectangles");
+        run(invalid_rects(), "Every invalid rectangle is reported");
+        run(past_limit(), "Rectangles past the limit are only counted");
+        run(syntax_error(), "Syntax error");
+        run(not_an_object(), "Top level must be an object");
+        run(rects_not_an_array(), "\"rects\" must be an array");
+        run_file("{\"rects\": []}\n", "Mapped file contents");
+        run_file("", "Empty file contents");
+        run_missing_file();
+        run_narrowest_coordinates();
+        run_binary_round_trip();
+        run_binary_errors();
+        std::cout << "\n";
+    }
+
+    // Writes contents to a temporary file and reads it back through InputFile
+    static void run_file(const string &contents, string name)
+    {
+        auto path = std::filesystem::temp_directory_path() / "nitro_input_test.json";
+        std::ofstream(path) << contents;
+        auto file = InputFile::open(path.string());
+        bool passed = file.has_value() && file->contents() == contents;
+        std::filesystem::remove(path);
+        print_test_case(passed, name, [&file]()
+                        { return file.has_value() ? "\t got: " + string(file->contents()) + "\n" : "\t could not open file\n"; });
+    }
+
+    // The narrowest type holding x + w and y + h, on both sides of each boundary
+    static void run_narrowest_coordinates()
+    {
+        auto narrowest = [](uint32_t x, uint32_t y)
+        {
+            return narrowest_coordinates({Rectangle({.x = x, .y = y, .w = 1, .h = 1})});
+        };
+        bool passed = narrowest_coordinates({}) == CoordinateType::Uint16 &&
+                      narrowest(UINT16_MAX - 1, 0) == CoordinateType::Uint16 &&
+                      narrowest(UINT16_MAX, 0) == CoordinateType::Uint32 &&
+                      narrowest(0, UINT16_MAX) == CoordinateType::Uint32 &&
+                      narrowest(UINT32_MAX - 1, 0) == CoordinateType::Uint32 &&
+                      narrowest(0, UINT32_MAX) == CoordinateType::Uint64;
+        print_test_case(passed, "Narrowest coordinates hold every range end", []()
+                        { return string("\t picked the wrong coordinate type\n"); });
+    }
+
+    // Both documents of each set of rectangles read back the same rectangles, binary ones in the narrowest coordinates
+    static void run_binary_round_trip()
+    {
+        vector<vector<Rectangle>> sets = {
+            {},
+            {Rectangle({.x = 1, .y = 2, .w = 3, .h = 4}), Rectangle({.x = UINT16_MAX - 1, .y = 0, .w = 1, .h = 1})},
+            {Rectangle({.x = 1, .y = 2, .w = 3, .h = 4}), Rectangle({.x = 70000, .y = 5, .w = 6, .h = 7})},
+            {Rectangle({.x = UINT32_MAX, .y = 5, .w = 5, .h = UINT32_MAX}), Rectangle({.x = 0, .y = 0, .w = 1, .h = 1})},
+        };
+        bool passed = true;
+        for (const auto &rects : sets)
+        {
+            string binary = binary_rects_document(rects);
+            BinaryInput input = read_binary_rects(binary, SIZE_MAX);
+            auto read_back = std::visit([](const auto &stored)
+                                        { return convert_rectangles<uint32_t>(stored); }, input.rects);
+            ParsedInput parsed = parse_rects(json_rects_document(rects), SIZE_MAX);
+            passed = passed && is_binary_input(binary) && !is_binary_input(json_rects_document(rects)) &&
+                     binary.size() == BINARY_HEADER_SIZE + rects.size() * 4 * (size_t{2} << input.rects.index()) &&
+                     input.status == BinaryInput::Status::Ok && input.rect_count == rects.size() &&
+                     input.rects.index() == static_cast<size_t>(narrowest_coordinates(rects)) && read_back == rects &&
+                     parsed.status == ParsedInput::Status::Ok && parsed.rects == rects;
+        }
+        print_test_case(passed, "Binary and JSON documents round trip", []()
+                        { return string("\t rectangles differ after a round trip\n"); });
+    }
+
+    // Headers and records the binary reader rejects, and records past the limit it only counts
+    static void run_binary_errors()
+    {
+        string valid = binary_rects_document({Rectangle({.x = 1, .y = 2, .w = 3, .h = 4}), Rectangle({.x = 5, .y = 6, .w = 7, .h = 8})});
+        string bad_version = valid;
+        bad_version[4] = 2;
+        string bad_width = valid;
+        bad_width[5] = 3;
+        // a width 2 record of {x: 1, y: 2, w: 0, h: 4}, then one whose x + w wraps around
+        string invalid = valid.substr(0, 8) + string("\x04\0\0\0\0\0\0\0", 8) + valid.substr(BINARY_HEADER_SIZE) +
+                         string("\x01\0\x02\0\0\0\x04\0", 8) + string("\xff\xff\0\0\x01\0\x01\0", 8);
+        BinaryInput limited = read_binary_rects(valid, 1);
+        BinaryInput invalid_input = read_binary_rects(invalid, SIZE_MAX);
+        bool passed = read_binary_rects(valid.substr(0, 12), SIZE_MAX).status == BinaryInput::Status::BadHeader &&
+                      read_binary_rects(bad_version, SIZE_MAX).status == BinaryInput::Status::BadHeader &&
+                      read_binary_rects(bad_width, SIZE_MAX).status == BinaryInput::Status::BadHeader &&
+                      read_binary_rects(valid.substr(0, valid.size() - 1), SIZE_MAX).status == BinaryInput::Status::SizeMismatch &&
+                      read_binary_rects(valid + valid.substr(BINARY_HEADER_SIZE), SIZE_MAX).status == BinaryInput::Status::SizeMismatch &&
+                      limited.status == BinaryInput::Status::Ok && limited.rect_count == 2 &&
+                      std::get<0>(limited.rects) == vector<BasicRectangle<uint16_t>>{BasicRectangle<uint16_t>({.x = 1, .y = 2, .w = 3, .h = 4})} &&
+                      invalid_input.status == BinaryInput::Status::InvalidRects && invalid_input.rect_count == 4 && std::get<0>(invalid_input.rects).size() == 2 &&
+                      invalid_input.invalid_rects == vector<string>{R"({"x":1,"y":2,"w":0,"h":4})", R"({"x":65535,"y":0,"w":1,"h":1})"};
+        print_test_case(passed, "Binary headers and records are validated", [&invalid_input]()
+                        {
+            std::ostringstream os;
+            for (const auto &rect : invalid_input.invalid_rects) {
+                os << "\t invalid: " << rect << "\n";
+            }
+            return os.str(); });
+    }
+
+    static void run_missing_file()
+    {
+        auto file = InputFile::open("this/file/does/not/exist.json");
+        print_test_case(!file.has_value(), "Missing file", []()
+                        { return string("\t opened a file that doesn't exist\n"); });
+    }
+
+    static void run(const TestCase &test_case, string name)
+    {
+        auto actual = parse_rects(test_case.inputs.first, test_case.inputs.second);
+        auto const &expected = test_case.expected;
+        bool passed = actual.status == expected.status;
+        if (expected.status == ParsedInput::Status::Ok || expected.status == ParsedInput::Status::InvalidRects)
+        {
+            passed = passed && actual.rects == expected.rects && actual.rect_count == expected.rect_count && actual.invalid_rects == expected.invalid_rects;
+        }
+        print_test_case(passed, name, [&actual]()
+                        {
+            std::ostringstream os;
+            os << "\t got status " << static_cast<int>(actual.status) << ", " << actual.rect_count << " elements:\n" << actual.rects;
+            for (auto const &invalid : actual.invalid_rects) {
+                os << "\t invalid: " << invalid << "\n";
+            }
+            return os.str(); });
+    }
+};
+
+// IdSet must behave exactly like the std::set<Id> it replaced
+class IdSetTest
+{
+    // Random sets over ids 1..max_id, paired with the equivalent std::set
+    static vector<std::pair<IdSet, std::set<Id>>> random_sets(uint32_t seed, size_t count, Id max_id)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<Id> id(1, max_id);
+        std::uniform_int_distribution<size_t> size(0, 6);
+        vector<std::pair<IdSet, std::set<Id>>> sets;
+        for (size_t i = 0; i < count; i += 1)
+        {
+            IdSet bits;
+            std::set<Id> reference;
+            for (size_t j = size(gen); j > 0; j -= 1)
+            {
+                Id next = id(gen);
+                bits.insert(next);
+                reference.insert(next);
+            }
+            sets.emplace_back(bits, reference);
+        }
+        return sets;
+    }
+
+    static string print(const IdSet &s)
+    {
+        std::ostringstream os;
+        os << s;
+        return os.str();
+    }
+
+    // the format operator<<(std::ostream &, const std::set<Id> &) used to print
+    static string print(const std::set<Id> &s)
+    {
+        if (s.size() < 2)
+        {
+            return "{}";
+        }
+        std::ostringstream os;
+        for (auto it = s.begin(); it != s.end(); ++it)
+        {
+            os << (it == s.begin() ? "" : std::next(it) == s.end() ? " and " : ", ") << *it;
+        }
+        return os.str();
+    }
+
+public:
+    static void runAll()
+    {
+        std::cout << "--> IdSet Tests";
+        run(random_sets(1, 200, 10), "Small ids behave like std::set");
+        run(random_sets(2, 200, 64), "Ids up to 64 behave like std::set");
+        run(random_sets(3, 200, 300), "Spilled ids behave like std::set");
+        run(random_sets(4, 100, 100000), "Sparse large ids behave like std::set");
+        std::cout << "\n";
+    }
+
+    static void run(const vector<std::pair<IdSet, std::set<Id>>> &sets, string name)
+    {
+        string failure;
+        for (auto const &[a, a_ref] : sets)
+        {
+            vector<Id> ids(a.begin(), a.end());
+            if (ids != vector<Id>(a_ref.begin(), a_ref.end()) || a.size() != a_ref.size() ||
+                a.max() != (a_ref.empty() ? 0 : *a_ref.rbegin()) || print(a) != print(a_ref))
+            {
+                failure = print(a) + " vs " + print(a_ref);
+                break;
+            }
+            for (auto const &[b, b_ref] : sets)
+            {
+                std::set<Id> both;
+                std::set_intersection(a_ref.begin(), a_ref.end(), b_ref.begin(), b_ref.end(), std::inserter(both, both.end()));
+                std::set<Id> difference;
+                std::set_difference(a_ref.begin(), a_ref.end(), b_ref.begin(), b_ref.end(), std::inserter(difference, difference.end()));
+                bool subset = std::includes(b_ref.begin(), b_ref.end(), a_ref.begin(), a_ref.end());
+                if ((a < b) != (a_ref < b_ref) || (a == b) != (a_ref == b_ref) ||
+                    (a == b && a.hash() != b.hash()) || a.is_subset_of(b) != subset || !((a & b) == IdSet(both.begin(), both.end())) ||
+                    a.common_size(b) != both.size() || !((a - b) == IdSet(difference.begin(), difference.end())))
+                {
+                    failure = print(a) + " against " + print(b);
+                    break;
+                }
+            }
+        }
+        print_test_case(failure.empty(), name, [&failure]()
+                        { return "\t mismatch for " + failure + "\n"; });
+    }
+};
+
+// intersect_batch must agree with Rectangle::intersect on every instruction set
+class IntersectKernelTest
+{
+    static vector<Rectangle> random_boxes(uint32_t seed, size_t count, uint32_t base, uint32_t extent)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<uint32_t> pos(0, extent);
+        std::uniform_int_distribution<uint32_t> size(1, extent);
+        vector<Rectangle> rects;
+        for (size_t i = 0; i < count; i += 1)
+        {
+            rects.push_back(Rectangle({.x = base + pos(gen), .y = base + pos(gen), .w = size(gen), .h = size(gen)}));
+        }
+        return rects;
+    }
+
+public:
+    static void runAll()
+    {
+        std::cout << "--> Intersect Kernel Tests";
+        for (Isa isa : {Isa::Scalar, Isa::Sse42, Isa::Avx2})
+        {
+            if (!isa_supported(isa))
+            {
+                continue;
+            }
+            string name = isa_name(isa);
+            run(random_boxes(1, 203, 0, 100), Rectangle({.x = 30, .y = 30, .w = 40, .h = 40}), isa, name + " kernel matches intersect");
+            // x + w wraps around uint32_t, which must behave exactly like Rectangle::intersect
+            run(random_boxes(2, 101, UINT32_MAX - 100, 100), Rectangle({.x = UINT32_MAX - 50, .y = UINT32_MAX - 50, .w = 20, .h = 20}), isa, name + " kernel matches intersect on wrap around");
+            using Rectangle16 = BasicRectangle<uint16_t>;
+            run(convert_rectangles<uint16_t>(random_boxes(3, 203, 0, 100)), Rectangle16({.x = 30, .y = 30, .w = 40, .h = 40}), isa, name + " uint16_t kernel matches intersect");
+            run(convert_rectangles<uint16_t>(random_boxes(4, 101, UINT16_MAX - 100, 100)), Rectangle16({.x = UINT16_MAX - 50, .y = UINT16_MAX - 50, .w = 20, .h = 20}), isa, name + " uint16_t kernel on wrap around");
+        }
+        std::cout << "\n";
+    }
+
+    template <typename T>
+    static void run(const vector<BasicRectangle<T>> &boxes, const BasicRectangle<T> &shape, Isa isa, string name)
+    {
+        BasicRectangleSoA<T> soa(boxes);
+        BasicRectangleSoA<T> clipped;
+        std::vector<uint64_t> hits;
+        // skip the first few boxes, so batches don't start on an aligned boundary
+        const size_t first = 3;
+        size_t count = intersect_batch(shape, soa, first, boxes.size() - first, clipped, hits, isa);
+
+        size_t expected_count = 0;
+        bool passed = true;
+        for (size_t i = first; i < boxes.size(); i += 1)
+        {
+            auto expected = shape.intersect(boxes[i]);
+            bool hit = (hits[(i - first) / 64] >> ((i - first) % 64) & 1) != 0;
+            expected_count += expected.has_value();
+            passed = passed && hit == expected.has_value() && (!hit || clipped.get(i - first) == *expected);
+        }
+        passed = passed && count == expected_count;
+        print_test_case(passed, name, [&]()
+                        { return "\t " + std::to_string(count) + " hits, expected " + std::to_string(expected_count) + "\n"; });
+    }
+};
+
+// Differential tests: every engine configuration must agree with the reference one
+class EngineTest
+{
+    static IntersectionOptions reference()
+    {
+        return IntersectionOptions{.broad_phase = BroadPhase::NestedLoop, .enumeration = Enumeration::Exhaustive, .dedup = Dedup::LinearScan};
+    }
+
+    // Reproducible pseudo-random scene. A small extent makes rectangles overlap a lot
+    static vector<Rectangle> random_scene(uint32_t seed, size_t count, uint32_t extent)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<uint32_t> pos(0, extent);
+        std::uniform_int_distribution<uint32_t> size(1, extent / 3 + 1);
+        vector<Rectangle> rects;
+        for (size_t i = 0; i < count; i += 1)
+        {
+            rects.push_back(Rectangle({.x = pos(gen), .y = pos(gen), .w = size(gen), .h = size(gen)}));
+        }
+        return rects;
+    }
+
+    // Rectangles on a grid, each one touching its neighbours without overlapping
+    static vector<Rectangle> adjacent_grid(uint32_t side)
+    {
+        vector<Rectangle> rects;
+        for (uint32_t i = 0; i < side; i += 1)
+        {
+            for (uint32_t j = 0; j < side; j += 1)
+            {
+                rects.push_back(Rectangle({.x = i * 10, .y = j * 10, .w = 10, .h = 10}));
+            }
+        }
+        return rects;
+    }
+
+    // Wide rows that all overlap on the x-axis, stacked so that each one only overlaps the next.
+    // Almost the whole active set of the sweep lies below or above every new row
+    static vector<Rectangle> stacked_rows(uint32_t count)
+    {
+        vector<Rectangle> rects;
+        for (uint32_t i = 0; i < count; i += 1)
+        {
+            rects.push_back(Rectangle({.x = i, .y = i * 10, .w = count * 10, .h = 12}));
+        }
+        return rects;
+    }
+
+    // Two families of thin vertical bars that never touch each other, crossed by horizontal bars.
+    // Every horizontal bar has a long row of later neighbours, none of which extends its pairs with the first family
+    static vector<Rectangle> crossing_bars(uint32_t count)
+    {
+        vector<Rectangle> rects;
+        for (uint32_t i = 0; i < count; i += 1)
+        {
+            rects.push_back(Rectangle({.x = i * 10, .y = 0, .w = 2, .h = count * 10}));
+        }
+        for (uint32_t i = 0; i < count; i += 1)
+        {
+            rects.push_back(Rectangle({.x = 0, .y = i * 10, .w = count * 10, .h = 2}));
+        }
+        for (uint32_t i = 0; i < count; i += 1)
+        {
+            rects.push_back(Rectangle({.x = i * 10 + 5, .y = 0, .w = 2, .h = count * 10}));
+        }
+        return rects;
+    }
+
+    static vector<Rectangle> simple_example()
+    {
+        Rectangle A({.x = 100, .y = 100, .w = 250, .h = 80});
+        Rectangle B({.x = 120, .y = 200, .w = 250, .h = 150});
+        Rectangle C({.x = 140, .y = 160, .w = 250, .h = 100});
+        Rectangle D({.x = 160, .y = 140, .w = 350, .h = 190});
+        return {A, B, C, D, A, B, C, D, D, D};
+    }
+
+    // A random scene where some rectangles are copies of earlier ones, in shuffled positions
+    static vector<Rectangle> with_duplicates(uint32_t seed, size_t count, size_t copies, uint32_t extent)
+    {
+        vector<Rectangle> rects = random_scene(seed, count, extent);
+        std::mt19937 gen(seed);
+        for (size_t i = 0; i < copies; i += 1)
+        {
+            rects.push_back(rects[std::uniform_int_distribution<size_t>(0, rects.size() - 1)(gen)]);
+        }
+        std::shuffle(rects.begin(), rects.end(), gen);
+        return rects;
+    }
+
+public:
+    static void runAll()
+    {
+        std::cout << "--> Engine Tests";
+        run_pairs(random_scene(1, 300, 1000), "Sweep pairs match nested loop (sparse)");
+        run_pairs(random_scene(2, 300, 100), "Sweep pairs match nested loop (dense)");
+        run_pairs(adjacent_grid(8), "Sweep pairs match nested loop (adjacent grid)");
+        run_pairs(stacked_rows(300), "Sweep pairs match nested loop (stacked rows)");
+        run(simple_example(), IntersectionOptions{.broad_phase = BroadPhase::Sweep}, "Sweep engine on simple example");
+        run(random_scene(3, 10, 60), IntersectionOptions{.broad_phase = BroadPhase::Sweep}, "Sweep engine on random scene");
+        run(simple_example(), IntersectionOptions{.enumeration = Enumeration::Exhaustive, .dedup = Dedup::Hashed}, "Hashed dedup on simple example");
+        run(random_scene(4, 10, 40), IntersectionOptions{.enumeration = Enumeration::Exhaustive, .dedup = Dedup::Hashed}, "Hashed dedup on random scene");
+        run(simple_example(), IntersectionOptions{.enumeration = Enumeration::Canonical}, "Canonical enumeration on simple example");
+        run(random_scene(5, 10, 40), IntersectionOptions{.enumeration = Enumeration::Canonical}, "Canonical enumeration on random scene");
+        run(adjacent_grid(3), IntersectionOptions{.enumeration = Enumeration::Canonical}, "Canonical enumeration on adjacent grid");
+        run(random_scene(5, 10, 40), IntersectionOptions{.small_search = false}, "Generic canonical walk on random scene");
+        for (Isa isa : {Isa::Scalar, Isa::Sse42, Isa::Avx2})
+        {
+            if (isa_supported(isa))
+            {
+                run(crossing_bars(40), IntersectionOptions{.isa = isa}, string("Batch kernel on crossing bars, ") + isa_name(isa));
+            }
+        }
+        run(random_scene(6, 12, 40), IntersectionOptions{.threads = 2}, "2 threads on random scene");
+        run(crossing_bars(40), IntersectionOptions{.threads = 4}, "4 threads on crossing bars");
+        run(simple_example(), IntersectionOptions{.threads = 0}, "One thread per core on simple example");
+        run_stream(simple_example(), "Stream yields the set in order (simple example)");
+        run_stream(random_scene(8, 14, 40), "Stream yields the set in order (random scene)");
+        run_stream(crossing_bars(40), "Stream yields the set in order (crossing bars)");
+        run_stream(random_scene(18, 64, 300), "Stream yields the set in order (64 rectangles)");
+        run_memory(crossing_bars(40), "Results outlive the caller's memory resource");
+        run_memory(random_scene(12, 14, 40), "Caller's memory resource on random scene");
+        run_tree(simple_example(), 2, SIZE_MAX, "Intersection tree of simple example");
+        run_tree(random_scene(13, 14, 40), 2, SIZE_MAX, "Intersection tree of random scene");
+        run_tree(crossing_bars(40), 2, SIZE_MAX, "Intersection tree past 64 ids");
+        run_tree(random_scene(14, 14, 40), 3, 4, "Intersection tree with degree bounds");
+        run_tree(simple_example(), 2, 1, "Intersection tree, empty degree bounds");
+        run_degree(random_scene(9, 14, 40), 3, 4, "Degree bounds on random scene");
+        run_degree(crossing_bars(12), 3, 3, "Degree bounds on crossing bars");
+        run_degree(simple_example(), 2, 1, "Empty degree bounds");
+        run_small<16>(simple_example(), 2, SIZE_MAX, "Small engine on simple example");
+        run_small<32>(random_scene(16, 30, 60), 2, SIZE_MAX, "Small engine on random scene");
+        run_small<64>(random_scene(17, 64, 300), 2, SIZE_MAX, "Small engine up to id 64");
+        run_small<64>(crossing_bars(21), 3, 3, "Small engine with degree bounds");
+        run_small<16>(simple_example(), 2, 1, "Small engine, empty degree bounds");
+        run_classes(simple_example(), "Duplicate classes of simple example");
+        run_classes(with_duplicates(19, 8, 6, 40), "Duplicate classes of random scene");
+        run_classes(random_scene(20, 14, 40), "Duplicate classes, all rectangles distinct");
+        run_class_ids(simple_example(), {{1, 5}, {2, 6}, {3, 7}, {4, 8, 9, 10}}, "Classes of simple example");
+        run_class_ids(with_duplicates(21, 1, 3, 40), {{1, 2, 3, 4}}, "Classes of a single rectangle");
+        run_top_k(random_scene(10, 14, 40), 7, {}, "Top 7 by area on random scene");
+        run_top_k(crossing_bars(12), 5, {}, "Top 5 by area, many ties");
+        run_top_k(random_scene(11, 14, 40), 4, {.min_degree = 3}, "Top 4 by area of degree 3 and up");
+        run_top_k(simple_example(), 1000, {}, "Top k larger than the output");
+        run_maximal(simple_example(), "Maximal intersections of simple example");
+        run_maximal(random_scene(7, 14, 40), "Maximal intersections of random scene");
+        run_maximal(adjacent_grid(4), "Maximal intersections of adjacent grid");
+        run_maximal(crossing_bars(10), "Maximal intersections of crossing bars");
+        run_coordinates<uint16_t>("uint16_t coordinates match uint32_t");
+        run_coordinates<uint64_t>("uint64_t coordinates match uint32_t");
+        run_coordinates<int32_t>("int32_t coordinates match uint32_t");
+        run_coordinates<float>("float coordinates match uint32_t");
+        run_wide_ends("Ends past UINT32_MAX meet on uint64_t coordinates");
+        std::cout << "\n";
+    }
+
+    // The engines find the same intersections whatever the coordinate type, on the batch kernel and off it
+    template <typename T>
+    static void run_coordinates(string name)
+    {
+        auto same = [](const BasicIntersection<T> &actual, const Intersection &expected)
+        {
+            const Rectangle &shape = expected.shape();
+            BasicRectangle<T> converted({.x = static_cast<T>(shape.m_x), .y = static_cast<T>(shape.m_y), .w = static_cast<T>(shape.m_w), .h = static_cast<T>(shape.m_h)});
+            return actual.ids() == expected.ids() && actual.shape() == converted;
+        };
+        bool passed = true;
+        for (const auto &inputs : {random_scene(15, 14, 40), crossing_bars(40)})
+        {
+            auto expected = Intersection::get_intersections(inputs);
+            auto actual = BasicIntersection<T>::get_intersections(convert_rectangles<T>(inputs));
+            passed = passed && actual.size() == expected.size() && std::equal(actual.begin(), actual.end(), expected.begin(), same);
+        }
+        print_test_case(passed, name, []()
+                        { return string("\t intersections differ from the uint32_t ones\n"); });
+    }
+
+    // Those ends wrap around on uint32_t coordinates, where the rectangles never meet. The loader picks uint64_t for them
+    static void run_wide_ends(string name)
+    {
+        vector<Rectangle> inputs = {
+            Rectangle({.x = UINT32_MAX - 5, .y = 0, .w = 10, .h = 10}),
+            Rectangle({.x = UINT32_MAX, .y = 5, .w = 5, .h = 10}),
+        };
+        std::set<BasicIntersection<uint64_t>> expected = {
+            BasicIntersection<uint64_t>(BasicRectangle<uint64_t>({.x = UINT32_MAX, .y = 5, .w = 5, .h = 5}), IdSet{1, 2}),
+        };
+        auto actual = BasicIntersection<uint64_t>::get_intersections(convert_rectangles<uint64_t>(inputs));
+        bool passed = narrowest_coordinates(inputs) == CoordinateType::Uint64 && actual == expected;
+        print_test_case(passed, name, [&actual]()
+                        {
+            std::ostringstream os;
+            os << "\t got:\n" << actual << "\n";
+            return os.str(); });
+    }
+
+    static void run_pairs(const vector<Rectangle> &inputs, string name)
+    {
+        auto expected = Intersection::overlapping_pairs(inputs, BroadPhase::NestedLoop);
+        auto actual = Intersection::overlapping_pairs(inputs, BroadPhase::Sweep);
+        print_test_case(actual == expected, name, [&expected, &actual]()
+                        {
+            std::ostringstream os;
+            os << "\t expected " << expected.size() << " pairs, got " << actual.size() << "\n";
+            return os.str(); });
+    }
+
+    static void run_stream(const vector<Rectangle> &inputs, string name)
+    {
+        auto expected = Intersection::get_intersections(inputs, reference());
+        vector<Intersection> actual;
+        IntersectionStream stream(inputs);
+        for (auto const &inter : stream)
+        {
+            actual.push_back(inter);
+        }
+        bool passed = actual.size() == expected.size() && std::equal(actual.begin(), actual.end(), expected.begin()) && !stream.next().has_value();
+        print_test_case(passed, name, [&expected, &actual]()
+                        {
+            std::ostringstream os;
+            os << "\t expected " << expected.size() << " intersections in order, got " << actual.size() << "\n";
+            return os.str(); });
+    }
+
+    // Engines working in a caller's arena return results that don't point into it:
+    // the arena is scribbled over after each call, before the results are compared
+    static void run_memory(const vector<Rectangle> &inputs, string name)
+    {
+        auto expected = Intersection::get_intersections(inputs, reference());
+        vector<std::byte> buffer(1 << 22);
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+        auto scribble = [&]()
+        {
+            arena.release();
+            std::fill(buffer.begin(), buffer.end(), std::byte{0xA5});
+        };
+        bool passed = true;
+        for (Enumeration enumeration : {Enumeration::Canonical, Enumeration::Exhaustive})
+        {
+            auto actual = Intersection::get_intersections(inputs, {.enumeration = enumeration, .memory = &arena});
+            scribble();
+            passed = passed && actual == expected;
+        }
+        vector<Intersection> streamed;
+        {
+            for (auto const &inter : IntersectionStream(inputs, {.memory = &arena}))
+            {
+                streamed.push_back(inter);
+            }
+        }
+        scribble();
+        passed = passed && std::equal(streamed.begin(), streamed.end(), expected.begin(), expected.end());
+        auto largest = Intersection::get_largest_intersections(inputs, 5, {.memory = &arena});
+        scribble();
+        passed = passed && largest == Intersection::get_largest_intersections(inputs, 5);
+        // workers share the resource, so it must be thread safe
+        std::pmr::synchronized_pool_resource pool;
+        passed = passed && Intersection::get_intersections(inputs, {.threads = 3, .memory = &pool}) == expected;
+        print_test_case(passed, name, []()
+                        { return string("	 results differ from the reference\n"); });
+    }
+
+    // Iteration rebuilds the reference output in order, and so does walking up from each node
+    static void run_tree(const vector<Rectangle> &inputs, size_t min_degree, size_t max_degree, string name)
+    {
+        auto expected = Intersection::get_intersections(inputs, reference());
+        std::erase_if(expected, [&](const Intersection &inter)
+                      { return inter.ids().size() < min_degree || inter.ids().size() > max_degree; });
+        IntersectionTree tree(inputs, {.min_degree = min_degree, .max_degree = max_degree});
+        vector<Intersection> actual(tree.begin(), tree.end());
+        bool passed = tree.size() == expected.size() && std::equal(actual.begin(), actual.end(), expected.begin(), expected.end());
+        size_t rebuilt = 0;
+        for (size_t node = 0; node < tree.nodes().size(); node += 1)
+        {
+            IdSet ids = tree.ids(node);
+            auto found = std::find_if(expected.begin(), expected.end(), [&ids](const Intersection &inter)
+                                      { return inter.ids() == ids; });
+            if (found != expected.end())
+            {
+                rebuilt += 1;
+                passed = passed && found->shape() == tree.nodes()[node].shape;
+            }
+        }
+        passed = passed && rebuilt == expected.size();
+        print_test_case(passed, name, [&]()
+                        {
+            std::ostringstream os;
+            os << "\t expected " << expected.size() << " intersections, size() is " << tree.size() << ", iterated "
+               << actual.size() << ", rebuilt " << rebuilt << " from nodes\n";
+            return os.str(); });
+    }
+
+    // Every engine against the reference output, filtered by degree
+    static void run_degree(const vector<Rectangle> &inputs, size_t min_degree, size_t max_degree, string name)
+    {
+        auto expected = Intersection::get_intersections(inputs, reference());
+        std::erase_if(expected, [&](const Intersection &inter)
+                      { return inter.ids().size() < min_degree || inter.ids().size() > max_degree; });
+        bool passed = true;
+        std::set<Intersection> actual;
+        for (IntersectionOptions options : {IntersectionOptions{}, IntersectionOptions{.small_search = false}, IntersectionOptions{.threads = 3}, IntersectionOptions{.enumeration = Enumeration::Exhaustive}})
+        {
+            options.min_degree = min_degree;
+            options.max_degree = max_degree;
+            actual = Intersection::get_intersections(inputs, options);
+            passed = passed && actual == expected;
+        }
+        print_test_case(passed, name, [&expected, &actual]()
+                        {
+            std::ostringstream os;
+            os << "\t expected: " << expected << "\n\t got: " << actual << "\n";
+            return os.str(); });
+    }
+
+    // get_intersections<N> against the reference output, filtered by degree
+    template <size_t N>
+    static void run_small(const vector<Rectangle> &inputs, size_t min_degree, size_t max_degree, string name)
+    {
+        auto expected = Intersection::get_intersections(inputs, reference());
+        std::erase_if(expected, [&](const Intersection &inter)
+                      { return inter.ids().size() < min_degree || inter.ids().size() > max_degree; });
+        auto actual = Intersection::get_intersections<N>(inputs, {.min_degree = min_degree, .max_degree = max_degree});
+        print_test_case(actual == expected, name, [&expected, &actual]()
+                        {
+            std::ostringstream os;
+            os << "\t expected: " << expected << "\n\t got: " << actual << "\n";
+            return os.str(); });
+    }
+
+    // The class intersections come out in order, and expand back into the whole output, each intersection once
+    static void run_classes(const vector<Rectangle> &inputs, string name)
+    {
+        auto expected = Intersection::get_intersections(inputs, reference());
+        DuplicateClasses<uint32_t> classes(inputs);
+        ClassIntersectionStream<uint32_t> stream(classes);
+        std::set<Intersection> actual;
+        size_t expanded = 0;
+        bool ordered = true;
+        std::optional<vector<size_t>> previous;
+        for (auto inter = stream.next(); inter.has_value(); inter = stream.next())
+        {
+            ordered = ordered && (!previous.has_value() || *previous < inter->classes);
+            previous = inter->classes;
+            ClassExpansion<uint32_t> expansion(classes, *inter);
+            for (auto expanded_inter = expansion.next(); expanded_inter.has_value(); expanded_inter = expansion.next())
+            {
+                expanded += 1;
+                actual.insert(std::move(*expanded_inter));
+            }
+        }
+        bool passed = ordered && expanded == expected.size() && actual == expected;
+        print_test_case(passed, name, [&expected, &actual, ordered, expanded]()
+                        {
+            std::ostringstream os;
+            os << "	 in order: " << ordered << ", " << expanded << " expanded\n\t expected: " << expected << "\n\t got: " << actual << "\n";
+            return os.str(); });
+    }
+
+    // The ids of every class, classes numbered by their smallest id
+    static void run_class_ids(const vector<Rectangle> &inputs, const vector<vector<Id>> &expected, string name)
+    {
+        DuplicateClasses<uint32_t> classes(inputs);
+        vector<vector<Id>> actual;
+        for (size_t k = 0; k < classes.size(); k += 1)
+        {
+            actual.emplace_back(classes.ids(k).begin(), classes.ids(k).end());
+        }
+        bool passed = actual == expected && classes.representatives().size() == classes.size();
+        print_test_case(passed, name, [&actual]()
+                        {
+            std::ostringstream os;
+            os << "\t got " << actual.size() << " classes:";
+            for (const auto &ids : actual)
+            {
+                os << " {";
+                for (Id id : ids)
+                {
+                    os << " " << id;
+                }
+                os << " }";
+            }
+            os << "\n";
+            return os.str(); });
+    }
+
+    // Reference: the whole output sorted by decreasing area, then ids
+    static void run_top_k(const vector<Rectangle> &inputs, size_t k, IntersectionOptions options, string name)
+    {
+        IntersectionOptions filtered = reference();
+        filtered.min_degree = options.min_degree;
+        auto all = Intersection::get_intersections(inputs, filtered);
+        vector<Intersection> expected(all.begin(), all.end());
+        std::stable_sort(expected.begin(), expected.end(), [](const Intersection &lhs, const Intersection &rhs)
+                         { return lhs.shape().area() > rhs.shape().area(); });
+        expected.resize(std::min(k, expected.size()), expected.front());
+        auto actual = Intersection::get_largest_intersections(inputs, k, options);
+        print_test_case(actual == expected, name, [&expected, &actual]()
+                        {
+            std::ostringstream os;
+            os << "\t expected: " << std::set<Intersection>(expected.begin(), expected.end())
+               << "\n\t got: " << std::set<Intersection>(actual.begin(), actual.end()) << "\n";
+            return os.str(); });
+    }
+
+    // Reference: every intersection whose ids are not a strict subset of another one's
+    static void run_maximal(const vector<Rectangle> &inputs, string name)
+    {
+        auto all = Intersection::get_intersections(inputs, reference());
+        std::set<Intersection> expected;
+        std::copy_if(all.begin(), all.end(), std::inserter(expected, expected.end()), [&all](const Intersection &inter)
+                     { return std::none_of(all.begin(), all.end(), [&inter](const Intersection &other)
+                                           { return other.ids().size() > inter.ids().size() && inter.ids().is_subset_of(other.ids()); }); });
+        auto actual = Intersection::get_maximal_intersections(inputs);
+        print_test_case(actual == expected, name, [&expected, &actual]()
+                        {
+            std::ostringstream os;
+            os << "\t expected: " << expected << "\n\t got: " << actual << "\n";
+            return os.str(); });
+    }
+
+    static void run(const vector<Rectangle> &inputs, const IntersectionOptions &options, string name)
+    {
+        auto expected = Intersection::get_intersections(inputs, reference());
+        auto actual = Intersection::get_intersections(inputs, options);
+        print_test_case(actual == expected, name, [&expected, &actual]()
+                        {
+            std::ostringstream os;
+            os << "\t expected: " << expected << "\n\t got: " << actual << "\n";
+            return os.str(); });
+    }
+};
+
+class OutputTest
+{
+    using TestCase = ITestCase<std::pair<vector<Rectangle>, OutputFormat>, string>;
+
+    static vector<Rectangle> two_overlaps()
+    {
+        return {
+            Rectangle({.x = 0, .y = 0, .w = 10, .h = 10}),
+            Rectangle({.x = 5, .y = 5, .w = 10, .h = 10}),
+            Rectangle({.x = 4294967290, .y = 4, .w = 5, .h = 4000000000}),
+            Rectangle({.x = 8, .y = 0, .w = 1, .h = 20}),
+        };
+    }
+
+    // same text as the operator<< overloads
+    static TestCase text()
+    {
+        std::ostringstream os;
+        os << "Input:\n"
+           << two_overlaps() << "Intersections:\n"
+           << Intersection::get_intersections(two_overlaps());
+        return TestCase{.inputs = {two_overlaps(), OutputFormat::Text}, .expected = os.str()};
+    }
+
+    static TestCase ndjson()
+    {
+        return TestCase{
+            .inputs = {two_overlaps(), OutputFormat::Ndjson},
+            .expected = "{\"ids\":[1,2],\"x\":5,\"y\":5,\"w\":5,\"h\":5}\n"
+                        "{\"ids\":[1,2,4],\"x\":8,\"y\":5,\"w\":1,\"h\":5}\n"
+                        "{\"ids\":[1,4],\"x\":8,\"y\":0,\"w\":1,\"h\":10}\n"
+                        "{\"ids\":[2,4],\"x\":8,\"y\":5,\"w\":1,\"h\":10}\n"};
+    }
+
+    static TestCase csv()
+    {
+        return TestCase{
+            .inputs = {two_overlaps(), OutputFormat::Csv},
+            .expected = "ids,x,y,w,h\n"
+                        "1 2,5,5,5,5\n"
+                        "1 2 4,8,5,1,5\n"
+                        "1 4,8,0,1,10\n"
+                        "2 4,8,5,1,10\n"};
+    }
+
+public:
+    static void runAll()
+    {
+        std::cout << "--> Output Tests";
+        run(text(), "Text matches operator<<");
+        run(ndjson(), "NDJSON lines");
+        run(csv(), "CSV rows");
+        run_large();
+        run_coverage(OutputFormat::Text, "\tDepth 1: area 75, covered by at least 1 rectangle: 100\n\tDepth 2 or more: area 25, covered by at least 2 rectangles: 25\n", "Text coverage, capped");
+        run_coverage(OutputFormat::Ndjson, "{\"max_depth\":3}\n{\"depth\":1,\"or_more\":false,\"area\":75,\"area_at_least\":100}\n{\"depth\":2,\"or_more\":true,\"area\":25,\"area_at_least\":25}\n", "NDJSON coverage, capped");
+        run_coverage(OutputFormat::Csv, "depth,or_more,area,area_at_least,max_depth\n1,false,75,100,3\n2,true,25,25,3\n", "CSV coverage, capped");
+        run_huge_coverage();
+        run_classes(OutputFormat::Text, "\tBetween rectangle {1|5}, 2 and {3|4|6} at Rectangle(x=5, y=5, w=5, h=5)\n", "Text line of duplicate classes");
+        run_classes(OutputFormat::Ndjson, "{\"classes\":[[1,5],[2],[3,4,6]],\"x\":5,\"y\":5,\"w\":5,\"h\":5}\n", "NDJSON line of duplicate classes");
+        run_classes(OutputFormat::Csv, "1|5 2 3|4|6,5,5,5,5\n", "CSV row of duplicate classes");
+        std::cout << "\n";
+    }
+
+    static void run(const TestCase &test_case, string name)
+    {
+        std::ostringstream os;
+        {
+            OutputWriter out(os, test_case.inputs.second);
+            out.write_inputs(test_case.inputs.first);
+            out.begin_intersections("Intersections:");
+            for (auto const &inter : Intersection::get_intersections(test_case.inputs.first))
+            {
+                out.write(inter);
+            }
+            out.end_intersections();
+        }
+        string actual = os.str();
+        print_test_case(actual == test_case.expected, name, [&test_case, &actual]()
+                        { return "\t expected:\n" + test_case.expected + "\n\t got:\n" + actual + "\n"; });
+    }
+
+    // Coverage with the levels cut off at 2 below a max depth of 3
+    static void run_coverage(OutputFormat format, string expected_end, string name)
+    {
+        CoverageStats stats{.max_depth = 3, .levels = 2, .area_at_least = {0, 100, 25}, .depth_area = {0, 75, 25}};
+        std::ostringstream os;
+        {
+            OutputWriter out(os, format);
+            out.write_coverage(stats);
+        }
+        string actual = os.str();
+        print_test_case(actual.ends_with(expected_end), name, [&expected_end, &actual]()
+                        { return "\t expected:\n" + expected_end + "\t got:\n" + actual; });
+    }
+
+    // Areas past 2^64, which 64 bit coordinates reach, are printed in full
+    static void run_huge_coverage()
+    {
+        CoverageArea any = (CoverageArea{1} << 65) + 3;
+        CoverageArea both = (CoverageArea{1} << 64) + 1;
+        CoverageStats stats{.max_depth = 2, .levels = 2, .area_at_least = {0, any, both}, .depth_area = {0, any - both, both}};
+        std::ostringstream os;
+        {
+            OutputWriter out(os, OutputFormat::Csv);
+            out.write_coverage(stats);
+        }
+        string expected = "depth,or_more,area,area_at_least,max_depth\n"
+                          "1,false,18446744073709551618,36893488147419103235,2\n"
+                          "2,false,18446744073709551617,18446744073709551617,2\n";
+        string actual = os.str();
+        print_test_case(actual == expected, "Coverage areas past 2^64 printed in full", [&expected, &actual]()
+                        { return "\t expected:\n" + expected + "\t got:\n" + actual; });
+    }
+
+    // The line of the intersection of all the classes of the rectangles A, B, C, C, A and C
+    static void run_classes(OutputFormat format, string expected_line, string name)
+    {
+        Rectangle a({.x = 0, .y = 0, .w = 10, .h = 10});
+        Rectangle b({.x = 5, .y = 5, .w = 10, .h = 10});
+        Rectangle c({.x = 5, .y = 0, .w = 10, .h = 10});
+        DuplicateClasses<uint32_t> classes({a, b, c, c, a, c});
+        ClassIntersection<uint32_t> inter{.shape = Rectangle({.x = 5, .y = 5, .w = 5, .h = 5}), .classes = {0, 1, 2}};
+        std::ostringstream os;
+        {
+            OutputWriter out(os, format);
+            out.write(inter, classes);
+        }
+        string actual = os.str();
+        print_test_case(actual.ends_with(expected_line), name, [&expected_line, &actual]()
+                        { return "\t expected:\n" + expected_line + "\t got:\n" + actual; });
+    }
+
+    // Outputs larger than the buffer are flushed along the way, and still match
+    static void run_large()
+    {
+        vector<Rectangle> bars;
+        for (uint32_t i = 0; i < 60; i += 1)
+        {
+            bars.push_back(Rectangle({.x = i * 10, .y = 0, .w = 5, .h = 1000}));
+            bars.push_back(Rectangle({.x = 0, .y = i * 10, .w = 1000, .h = 5}));
+        }
+        std::ostringstream expected;
+        expected << "Input:\n"
+                 << bars << "Intersections:\n"
+                 << Intersection::get_intersections(bars);
+        std::ostringstream actual;
+        {
+            OutputWriter out(actual, OutputFormat::Text);
+            out.write_inputs(bars);
+            out.begin_intersections("Intersections:");
+            for (auto const &inter : IntersectionStream(bars))
+            {
+                out.write(inter);
+            }
+            out.end_intersections();
+        }
+        print_test_case(actual.str() == expected.str(), "Text matches operator<< past the buffer size", [&actual, &expected]()
+                        { return "\t expected " + std::to_string(expected.str().size()) + " bytes, got " + std::to_string(actual.str().size()) + "\n"; });
+    }
+};
+
+class CoverageTest
+{
+    // Reference: depth of every cell of the grid made by all the rectangle edges
+    static CoverageStats brute_force(const vector<Rectangle> &rects)
+    {
+        vector<uint64_t> xs, ys;
+        for (const Rectangle &r : rects)
+        {
+            xs.insert(xs.end(), {r.m_x, uint64_t{r.m_x} + r.m_w});
+            ys.insert(ys.end(), {r.m_y, uint64_t{r.m_y} + r.m_h});
+        }
+        std::sort(xs.begin(), xs.end());
+        std::sort(ys.begin(), ys.end());
+        vector<CoverageArea> depth_area(rects.size() + 1, 0);
+        size_t max_depth = 0;
+        for (size_t i = 0; i + 1 < xs.size(); i += 1)
+        {
+            for (size_t j = 0; j + 1 < ys.size(); j += 1)
+            {
+                size_t depth = std::count_if(rects.begin(), rects.end(), [&](const Rectangle &r)
+                                             { return r.m_x <= xs[i] && xs[i] < uint64_t{r.m_x} + r.m_w && r.m_y <= ys[j] && ys[j] < uint64_t{r.m_y} + r.m_h; });
+                depth_area[depth] += CoverageArea{xs[i + 1] - xs[i]} * (ys[j + 1] - ys[j]);
+                if (xs[i + 1] != xs[i] && ys[j + 1] != ys[j])
+                {
+                    max_depth = std::max(max_depth, depth);
+                }
+            }
+        }
+        CoverageStats stats{.max_depth = max_depth, .levels = max_depth, .area_at_least = vector<CoverageArea>(max_depth + 1, 0), .depth_area = vector<CoverageArea>(max_depth + 1, 0)};
+        for (size_t k = max_depth; k > 0; k -= 1)
+        {
+            stats.depth_area[k] = depth_area[k];
+            stats.area_at_least[k] = depth_area[k] + (k < max_depth ? stats.area_at_least[k + 1] : 0);
+        }
+        return stats;
+    }
+
+    static vector<Rectangle> random_scene(uint32_t seed, size_t count, uint32_t span)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<uint32_t> coordinate(0, span);
+        std::uniform_int_distribution<uint32_t> size(1, span / 3);
+        vector<Rectangle> rects;
+        for (size_t i = 0; i < count; i += 1)
+        {
+            rects.push_back(Rectangle({.x = coordinate(gen), .y = coordinate(gen), .w = size(gen), .h = size(gen)}));
+        }
+        return rects;
+    }
+
+    // Every rectangle sticks out of the previous one on a different side, so each node of the sweep's tree sees many depths
+    static vector<Rectangle> staircase(uint32_t count)
+    {
+        vector<Rectangle> rects;
+        for (uint32_t i = 0; i < count; i += 1)
+        {
+            rects.push_back(Rectangle({.x = i * (i % 2), .y = i * (1 - i % 2), .w = 2 * count, .h = 2 * count}));
+        }
+        return rects;
+    }
+
+public:
+    static void runAll()
+    {
+        std::cout << "--> Coverage Tests";
+        run(random_scene(1, 30, 100), "Coverage of a random scene");
+        run(random_scene(2, 60, 40), "Coverage of a dense random scene");
+        run({Rectangle({.x = 0, .y = 0, .w = 10, .h = 10}), Rectangle({.x = 10, .y = 0, .w = 10, .h = 10}), Rectangle({.x = 0, .y = 10, .w = 20, .h = 5})},
+            "Adjacent rectangles don't stack");
+        run({}, "Coverage of no rectangles");
+        run(staircase(40), "Coverage of 40 stacked rectangles");
+        run_capped();
+        run_max_depth();
+        run_wrapping();
+        run_huge_area();
+        std::cout << "\n";
+    }
+
+    static void run(const vector<Rectangle> &rects, string name)
+    {
+        auto expected = brute_force(rects);
+        auto actual = coverage_stats(rects);
+        bool passed = actual.max_depth == expected.max_depth && actual.levels == expected.levels &&
+                      actual.area_at_least == expected.area_at_least && actual.depth_area == expected.depth_area;
+        print_test_case(passed, name, [&expected, &actual]()
+                        {
+            std::ostringstream os;
+            os << "\t expected max depth " << expected.max_depth << ", got " << actual.max_depth << "\n";
+            for (size_t k = 1; k < std::min(expected.area_at_least.size(), actual.area_at_least.size()); k += 1) {
+                os << "\t at least " << k << ": expected " << area_digits(expected.area_at_least[k]) << ", got " << area_digits(actual.area_at_least[k]) << "\n";
+            }
+            return os.str(); });
+    }
+
+    // The last level holds everything deeper
+    static void run_capped()
+    {
+        auto rects = random_scene(3, 60, 40);
+        auto expected = brute_force(rects);
+        auto actual = coverage_stats(rects, 3);
+        bool passed = expected.max_depth > 3 && actual.max_depth == expected.max_depth && actual.levels == 3 &&
+                      std::equal(actual.area_at_least.begin(), actual.area_at_least.end(), expected.area_at_least.begin()) &&
+                      actual.depth_area[2] == expected.depth_area[2] && actual.depth_area[3] == expected.area_at_least[3];
+        print_test_case(passed, "Capped levels", []()
+                        { return string("\t capped coverage doesn't match the full one\n"); });
+    }
+
+    // Ranges that end past UINT32_MAX are counted once the rectangles are widened to uint64_t, like the engines do
+    static void run_wrapping()
+    {
+        vector<Rectangle> rects = {
+            Rectangle({.x = UINT32_MAX, .y = 0, .w = 1, .h = 10}),
+            Rectangle({.x = UINT32_MAX - 5, .y = 5, .w = 10, .h = 10}),
+            Rectangle({.x = UINT32_MAX - 2, .y = UINT32_MAX - 1, .w = 4, .h = 3}),
+            Rectangle({.x = UINT32_MAX - 3, .y = 2, .w = 5, .h = 20}),
+        };
+        auto expected = brute_force(rects);
+        auto actual = coverage_stats(convert_rectangles<uint64_t>(rects));
+        bool passed = narrowest_coordinates(rects) == CoordinateType::Uint64 && expected.max_depth == 3 &&
+                      actual.max_depth == expected.max_depth && actual.area_at_least == expected.area_at_least &&
+                      actual.depth_area == expected.depth_area;
+        print_test_case(passed, "Coverage of rectangles wrapping around uint32_t", [&expected, &actual]()
+                        {
+            std::ostringstream os;
+            os << "\t expected max depth " << expected.max_depth << ", got " << actual.max_depth << "\n";
+            for (size_t k = 1; k < std::min(expected.area_at_least.size(), actual.area_at_least.size()); k += 1) {
+                os << "\t at least " << k << ": expected " << area_digits(expected.area_at_least[k]) << ", got " << area_digits(actual.area_at_least[k]) << "\n";
+            }
+            return os.str(); });
+    }
+
+    // Widened to uint64_t, two rectangles almost 2^32 on a side cover more than 2^64
+    static void run_huge_area()
+    {
+        uint64_t side = UINT32_MAX;
+        uint64_t overlap = side - (uint64_t{1} << 31);
+        vector<Rectangle> rects = {
+            Rectangle({.x = 0, .y = 0, .w = UINT32_MAX, .h = UINT32_MAX}),
+            Rectangle({.x = 1u << 31, .y = 1u << 31, .w = UINT32_MAX, .h = UINT32_MAX}),
+        };
+        CoverageArea both = CoverageArea{overlap} * overlap;
+        CoverageArea any = 2 * CoverageArea{side} * side - both;
+        auto actual = coverage_stats(convert_rectangles<uint64_t>(rects));
+        bool passed = any > CoverageArea{UINT64_MAX} && area_digits(CoverageArea{1} << 64) == "18446744073709551616" && actual.max_depth == 2 &&
+                      actual.area_at_least == vector<CoverageArea>{0, any, both} && actual.depth_area == vector<CoverageArea>{0, any - both, both};
+        print_test_case(passed, "Coverage areas past 2^64", [&]()
+                        {
+            std::ostringstream os;
+            os << "\t expected " << area_digits(any) << " and " << area_digits(both) << ", got";
+            for (size_t k = 1; k < actual.area_at_least.size(); k += 1) {
+                os << " " << area_digits(actual.area_at_least[k]);
+            }
+            os << "\n";
+            return os.str(); });
+    }
+
+    // Helly property: the deepest point is where the largest intersection is
+    static void run_max_depth()
+    {
+        auto rects = random_scene(4, 14, 100);
+        size_t largest = 1;
+        for (auto const &inter : Intersection::get_intersections(rects))
+        {
+            largest = std::max(largest, inter.ids().size());
+        }
+        auto actual = coverage_stats(rects).max_depth;
+        print_test_case(actual == largest, "Max depth is the largest intersection degree", [largest, actual]()
+                        { return "\t expected " + std::to_string(largest) + ", got " + std::to_string(actual) + "\n"; });
+    }
+};
+
+class SpatialIndexTest
+{
+    static vector<Rectangle> random_scene(uint32_t seed, size_t count, uint32_t span, uint32_t max_size)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<uint32_t> coordinate(0, span);
+        std::uniform_int_distribution<uint32_t> size(1, max_size);
+        vector<Rectangle> rects;
+        for (size_t i = 0; i < count; i += 1)
+        {
+            rects.push_back(Rectangle({.x = coordinate(gen), .y = coordinate(gen), .w = size(gen), .h = size(gen)}));
+        }
+        return rects;
+    }
+
+    static bool contains(const Rectangle &rect, Point point)
+    {
+        return rect.m_x <= point.x && point.x < uint64_t{rect.m_x} + rect.m_w && rect.m_y <= point.y && point.y < uint64_t{rect.m_y} + rect.m_h;
+    }
+
+    static vector<Point> random_points(uint32_t seed, size_t count, uint32_t span)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<uint32_t> coordinate(0, span);
+        vector<Point> points;
+        for (size_t i = 0; i < count; i += 1)
+        {
+            points.push_back(Point{.x = coordinate(gen), .y = coordinate(gen)});
+        }
+        return points;
+    }
+
+public:
+    static void runAll()
+    {
+        std::cout << "--> Spatial Index Tests";
+        run(random_scene(1, 2000, 10000, 150), 10000, "Queries on a sparse scene");
+        run(random_scene(2, 300, 1000, 60), 1000, "Queries on a dense scene");
+        run(random_scene(3, 14, 100, 25), 100, "Queries on a small scene");
+        run({}, 100, "Queries on an empty index");
+        run({Rectangle({.x = UINT32_MAX - 5, .y = 0, .w = 10, .h = 10}), Rectangle({.x = 0, .y = 0, .w = 10, .h = 10})}, 20,
+            "Wrapping rectangles never match");
+        std::cout << "\n";
+    }
+
+    // Every query against a linear scan, through the batch APIs
+    static void run(const vector<Rectangle> &rects, uint32_t span, string name)
+    {
+        SpatialIndex index(rects);
+        auto all = Intersection::get_intersections(rects);
+        auto points = random_points(7, 300, span);
+        auto windows = random_scene(8, 300, span, span / 4);
+        auto rects_at = index.rectangles_at(points);
+        auto rects_in = index.rectangles_overlapping(windows);
+        auto inters_at = index.intersections_at(points);
+        auto inters_in = index.intersections_overlapping(windows);
+        string failure;
+        for (size_t q = 0; q < points.size() && failure.empty(); q += 1)
+        {
+            vector<Id> expected;
+            vector<Id> expected_in;
+            for (Id id = 1; id <= rects.size(); id += 1)
+            {
+                // wrapping rectangles can't overlap anything, see Rectangle::intersect
+                bool wraps = rects[id - 1].m_x + rects[id - 1].m_w < rects[id - 1].m_x;
+                if (!wraps && contains(rects[id - 1], points[q]))
+                {
+                    expected.push_back(id);
+                }
+                if (rects[id - 1].intersect(windows[q]).has_value())
+                {
+                    expected_in.push_back(id);
+                }
+            }
+            if (rects_at[q] != expected || rects_in[q] != expected_in)
+            {
+                failure = "rectangle query " + std::to_string(q);
+            }
+            vector<const Intersection *> expected_inters;
+            vector<const Intersection *> expected_inters_in;
+            for (auto const &inter : all)
+            {
+                if (contains(inter.shape(), points[q]))
+                {
+                    expected_inters.push_back(&inter);
+                }
+                if (inter.shape().intersect(windows[q]).has_value())
+                {
+                    expected_inters_in.push_back(&inter);
+                }
+            }
+            auto same = [](const vector<const Intersection *> &lhs, const vector<const Intersection *> &rhs)
+            {
+                return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Intersection *l, const Intersection *r)
+                                  { return *l == *r; });
+            };
+            if (!same(inters_at[q], expected_inters) || !same(inters_in[q], expected_inters_in))
+            {
+                failure = "intersection query " + std::to_string(q);
+            }
+        }
+        print_test_case(failure.empty(), name, [&failure]()
+                        { return "\t mismatch on " + failure + "\n"; });
+    }
+};
+
+class IntersectionIndexTest
+{
+    // Removed rectangles are replaced by one that wraps around and so overlaps nothing
+    static vector<Rectangle> reference_rects(const IntersectionIndex &index, Id count)
+    {
+        vector<Rectangle> rects;
+        for (Id id = 1; id <= count; id += 1)
+        {
+            rects.push_back(index.contains(id) ? index.rectangle(id) : Rectangle({.x = UINT32_MAX, .y = UINT32_MAX, .w = 1, .h = 1}));
+        }
+        return rects;
+    }
+
+public:
+    static void runAll()
+    {
+        std::cout << "--> Intersection Index Tests";
+        run(1, 0, 300, "Adds and removes from an empty index");
+        run(2, 20, 300, "Adds and removes from a bulk loaded index");
+        run(3, 60, 400, "Many removes trigger rebuilds");
+        run(4, 20, 300, "Degree bounds hold across changes", {.min_degree = 3, .max_degree = 4});
+        std::cout << "\n";
+    }
+
+    // Random changes, checked against get_intersections, with the change feed applied to a copy
+    static void run(uint32_t seed, size_t initial, size_t changes, string name, IntersectionOptions options = {})
+    {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<uint32_t> coordinate(0, 200);
+        std::uniform_int_distribution<uint32_t> size(1, 40);
+        std::uniform_int_distribution<int> percent(0, 99);
+        auto random_rect = [&]()
+        {
+            return Rectangle({.x = coordinate(gen), .y = coordinate(gen), .w = size(gen), .h = size(gen)});
+        };
+        vector<Rectangle> rects;
+        for (size_t i = 0; i < initial; i += 1)
+        {
+            rects.push_back(random_rect());
+        }
+        IntersectionIndex index(rects, options);
+        std::set<Intersection> mirror = index.intersections();
+        Id count = initial;
+        string failure;
+        // seed 3 removes more than it adds
+        int add_percent = seed == 3 ? 35 : 60;
+        for (size_t step = 1; step <= changes && failure.empty(); step += 1)
+        {
+            if (percent(gen) < add_percent || count == 0)
+            {
+                Id id = index.add(random_rect());
+                count += 1;
+                if (id != count)
+                {
+                    failure = "unexpected id at step " + std::to_string(step);
+                }
+            }
+            else
+            {
+                std::uniform_int_distribution<Id> any(1, count + 1);
+                Id id = any(gen);
+                bool existed = index.contains(id);
+                if (index.remove(id) != existed || index.contains(id))
+                {
+                    failure = "remove of " + std::to_string(id) + " at step " + std::to_string(step);
+                }
+            }
+            for (auto &change : index.take_changes())
+            {
+                bool applied = change.kind == IntersectionIndex::Change::Kind::Added ? mirror.insert(change.intersection).second
+                                                                                     : mirror.erase(change.intersection) == 1;
+                if (!applied)
+                {
+                    failure = "change feed at step " + std::to_string(step);
+                }
+            }
+            if (step % 20 == 0 || step == changes)
+            {
+                auto expected = Intersection::get_intersections(reference_rects(index, count), options);
+                if (index.intersections() != expected || mirror != expected)
+                {
+                    failure = "intersections at step " + std::to_string(step);
+                }
+            }
+        }
+        print_test_case(failure.empty(), name, [&failure]()
+                        { return "\t mismatch: " + failure + "\n"; });
+    }
+};
+
+class StatsTest
+{
+public:
+    static void runAll()
+    {
+        std::cout << "--> Stats Tests";
+        run_phase_timer();
+        run_counters();
+        std::cout << "\n";
+    }
+
+    static void run_phase_timer()
+    {
+        PhaseTimer disabled(false), enabled(true);
+        for (PhaseTimer *timer : {&disabled, &enabled})
+        {
+            auto scope = timer->time(Phase::Compute);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        {
+            auto scope = enabled.time(Phase::Compute);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        std::ostringstream json;
+        write_stats(json, enabled, Counters{});
+        bool passed = disabled.ms(Phase::Compute) == 0 && enabled.ms(Phase::Compute) >= 4 && enabled.ms(Phase::Print) == 0 &&
+                      json.str().starts_with("{\"phases_ms\":{\"read\":0,\"parse\":0,\"validate\":0,\"compute\":") &&
+                      json.str().ends_with(Stats::ENABLED ? "\"bytes_allocated\":0}}\n" : "\"counters\":null}\n");
+        print_test_case(passed, "Phase times add up, disabled ones stay 0", [&]()
+                        { return "\t disabled " + std::to_string(disabled.ms(Phase::Compute)) + " ms, enabled " +
+                                 std::to_string(enabled.ms(Phase::Compute)) + " ms, json: " + json.str(); });
+    }
+
+    // Without NITRO_STATS nothing is counted at all
+    static void run_counters()
+    {
+        vector<Rectangle> rects;
+        for (uint32_t i = 0; i < 8; i += 1)
+        {
+            rects.push_back(Rectangle({.x = i * 3, .y = i, .w = 10, .h = 10}));
+        }
+        size_t pairs = Intersection::overlapping_pairs(rects).size();
+        Stats::reset();
+        size_t canonical = Intersection::get_intersections(rects).size();
+        Counters after_canonical = Stats::totals();
+        Stats::reset();
+        size_t exhaustive = Intersection::get_intersections(rects, {.enumeration = Enumeration::Exhaustive}).size();
+        Counters after_exhaustive = Stats::totals();
+
+        bool passed;
+        if (Stats::ENABLED)
+        {
+            passed = after_canonical.pair_hits == pairs && after_canonical.intersections_emitted == canonical &&
+                     after_canonical.pairs_tested >= pairs && after_canonical.queue_high_water > 0 && after_canonical.allocations > 0 &&
+                     after_exhaustive.intersections_emitted == exhaustive &&
+                     after_exhaustive.dedup_misses == exhaustive - pairs && after_exhaustive.dedup_hits > 0;
+        }
+        else
+        {
+            passed = after_canonical == Counters{} && after_exhaustive == Counters{};
+        }
+        print_test_case(passed, "Engine counters", [&]()
+                        {
+                            std::ostringstream os;
+                            PhaseTimer timer(false);
+                            write_stats(os, timer, after_canonical);
+                            write_stats(os, timer, after_exhaustive);
+                            return "\t " + os.str(); });
+    }
+};
+
+class ServerTest
+{
+    // A connected client socket, -1 if it can't connect. Reads give up after 5 seconds, so a stuck server fails the test
+    static int connect_to(const string &path)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), address.sun_path);
+        timeval timeout{.tv_sec = 5, .tv_usec = 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Sends all the requests at once, then reads until every response has ended with its empty line.
+    // With hang_up, the client shuts its side down once the requests are sent
+    static string exchange(const string &path, const string &requests, size_t responses, bool hang_up = false)
+    {
+        int fd = connect_to(path);
+        if (fd < 0 || write(fd, requests.data(), requests.size()) != static_cast<ssize_t>(requests.size()))
+        {
+            close(fd);
+            return "could not send";
+        }
+        if (hang_up)
+        {
+            shutdown(fd, SHUT_WR);
+        }
+        string received;
+        char chunk[4096];
+        auto ended = [&]()
+        {
+            size_t count = 0;
+            for (size_t at = received.find("\n\n"); at != string::npos; at = received.find("\n\n", at + 2))
+            {
+                count += 1;
+            }
+            return count >= responses;
+        };
+        while (!ended())
+        {
+            ssize_t count = read(fd, chunk, sizeof(chunk));
+            if (count <= 0)
+            {
+                break;
+            }
+            received.append(chunk, count);
+        }
+        close(fd);
+        return received;
+    }
+
+public:
+    static void runAll()
+    {
+        std::cout << "--> Server Tests";
+        run_concurrent_clients();
+        run_empty_rectangle();
+        run_idle_clients();
+        run_long_request();
+        run_unterminated_request();
+        run_throwing_handler();
+        run_unread_responses();
+        run_stale_socket();
+        std::cout << "\n";
+    }
+
+    static void run_concurrent_clients()
+    {
+        string path = (std::filesystem::temp_directory_path() / "nitro_server_test.sock").string();
+        auto server = Server::listen(path);
+        if (!server.has_value())
+        {
+            print_test_case(false, "Concurrent clients", []()
+                            { return string("\t could not listen\n"); });
+            return;
+        }
+        std::thread serving([&server]()
+                            { server->run([](std::string_view request, std::ostream &response)
+                                          { response << "got " << request; },
+                                          2); });
+        vector<string> received(4);
+        vector<std::thread> clients;
+        for (size_t c = 0; c < received.size(); c += 1)
+        {
+            clients.emplace_back([&, c]()
+                                 {
+                                     string id = std::to_string(c);
+                                     received[c] = exchange(path, "a" + id + "\n\nb" + id + "\n", 2); });
+        }
+        for (auto &client : clients)
+        {
+            client.join();
+        }
+        server->stop();
+        serving.join();
+        bool passed = true;
+        for (size_t c = 0; c < received.size(); c += 1)
+        {
+            string id = std::to_string(c);
+            passed = passed && received[c] == "got a" + id + "\n\ngot b" + id + "\n\n";
+        }
+        print_test_case(passed, "Concurrent clients, empty lines skipped", [&received]()
+                        {
+            string all;
+            for (auto const &r : received) {
+                all += "\t got: " + r + "\n";
+            }
+            return all; });
+    }
+
+    // A rectangle of width 0 is reported as invalid rather than taking the server down, which keeps answering
+    static void run_empty_rectangle()
+    {
+        string path = (std::filesystem::temp_directory_path() / "nitro_server_empty.sock").string();
+        auto server = Server::listen(path);
+        if (!server.has_value())
+        {
+            print_test_case(false, "Empty rectangle request", []()
+                            { return string("\t could not listen\n"); });
+            return;
+        }
+        std::thread serving([&server]()
+                            { server->run([](std::string_view request, std::ostream &response)
+                                          {
+                                              ParsedInput parsed = parse_rects(request, SIZE_MAX);
+                                              response << parsed.rects.size() << " valid, " << parsed.invalid_rects.size() << " invalid"; },
+                                          2); });
+        string first = exchange(path, R"({"rects":[{"x":1,"y":2,"w":0,"h":4},{"x":1,"y":2,"w":3,"h":4}]})" "\n", 1);
+        string second = exchange(path, R"({"rects":[{"x":1,"y":2,"w":3,"h":4}]})" "\n", 1);
+        server->stop();
+        serving.join();
+        bool passed = first == "1 valid, 1 invalid\n\n" && second == "1 valid, 0 invalid\n\n";
+        print_test_case(passed, "Empty rectangle request, server still answers", [&first, &second]()
+                        { return "\t got: " + first + "\t then: " + second; });
+    }
+
+    // Clients that connect and send nothing don't hold the only worker
+    static void run_idle_clients()
+    {
+        string path = (std::filesystem::temp_directory_path() / "nitro_server_idle.sock").string();
+        auto server = Server::listen(path);
+        if (!server.has_value())
+        {
+            print_test_case(false, "Idle clients", []()
+                            { return string("\t could not listen\n"); });
+            return;
+        }
+        std::thread serving([&server]()
+                            { server->run([](std::string_view request, std::ostream &response)
+                                          { response << "got " << request; },
+                                          1); });
+        vector<int> idle = {connect_to(path), connect_to(path)};
+        string received = exchange(path, "a\n", 1);
+        for (int fd : idle)
+        {
+            close(fd);
+        }
+        server->stop();
+        serving.join();
+        print_test_case(received == "got a\n\n", "Idle clients don't hold the workers", [&received]()
+                        { return "\t got: " + received + "\n"; });
+    }
+
+    // Lines past the maximum are answered with an error, whether they come in one read or many, and the next one is answered
+    static void run_long_request()
+    {
+        string path = (std::filesystem::temp_directory_path() / "nitro_server_long.sock").string();
+        auto server = Server::listen(path);
+        if (!server.has_value())
+        {
+            print_test_case(false, "Long requests", []()
+                            { return string("\t could not listen\n"); });
+            return;
+        }
+        std::thread serving([&server]()
+                            { server->run([](std::string_view request, std::ostream &response)
+                                          { response << "got " << request; },
+                                          2, 16); });
+        string too_long = "Improper input: request longer than 16 bytes\n\n";
+        string received = exchange(path, string(20, 'a') + "\nb\n" + string(100000, 'c') + "\nd\n", 4);
+        server->stop();
+        serving.join();
+        bool passed = received == too_long + "got b\n\n" + too_long + "got d\n\n";
+        print_test_case(passed, "Long requests rejected, the next ones answered", [&received]()
+                        { return "\t got: " + received + "\n"; });
+    }
+
+    // The last request of a client that hangs up is answered even without its newline, unless it is too long
+    static void run_unterminated_request()
+    {
+        string path = (std::filesystem::temp_directory_path() / "nitro_server_unterminated.sock").string();
+        auto server = Server::listen(path);
+        if (!server.has_value())
+        {
+            print_test_case(false, "Unterminated request", []()
+                            { return string("\t could not listen\n"); });
+            return;
+        }
+        std::thread serving([&server]()
+                            { server->run([](std::string_view request, std::ostream &response)
+                                          {
+                                              ParsedInput parsed = parse_rects(request, SIZE_MAX);
+                                              response << parsed.rects.size() << " valid"; },
+                                          2, 64); });
+        string first = exchange(path, R"({"rects":[{"x":1,"y":2,"w":3,"h":4}]})" "\n" R"({"rects":[]})", 2, true);
+        string second = exchange(path, string(100, 'a'), 1, true);
+        server->stop();
+        serving.join();
+        bool passed = first == "1 valid\n\n0 valid\n\n" && second == "Improper input: request longer than 64 bytes\n\n";
+        print_test_case(passed, "Unterminated last request answered when the client hangs up", [&first, &second]()
+                        { return "\t got: " + first + "\t then: " + second; });
+    }
+
+    // A request whose handler throws is answered with an error, and the connection and server keep answering
+    static void run_throwing_handler()
+    {
+        string path = (std::filesystem::temp_directory_path() / "nitro_server_throwing.sock").string();
+        auto server = Server::listen(path);
+        if (!server.has_value())
+        {
+            print_test_case(false, "Throwing handler", []()
+                            { return string("\t could not listen\n"); });
+            return;
+        }
+        std::thread serving([&server]()
+                            { server->run([](std::string_view request, std::ostream &response)
+                                          {
+                                              response << "got " << request;
+                                              if (request == "throw")
+                                              {
+                                                  throw std::bad_alloc();
+                                              } },
+                                          1); });
+        string first = exchange(path, "throw\na\n", 2);
+        string second = exchange(path, "b\n", 1);
+        server->stop();
+        serving.join();
+        string error = "Error: Could not answer the request: " + string(std::bad_alloc().what()) + "\n\n";
+        bool passed = first == error + "got a\n\n" && second == "got b\n\n";
+        print_test_case(passed, "Throwing handler answered with an error, server still answers", [&first, &second]()
+                        { return "\t got: " + first + "\t then: " + second; });
+    }
+
+    // A client that sends requests but never reads its responses doesn't hold the only worker
+    static void run_unread_responses()
+    {
+        string path = (std::filesystem::temp_directory_path() / "nitro_server_unread.sock").string();
+        auto server = Server::listen(path);
+        if (!server.has_value())
+        {
+            print_test_case(false, "Unread responses", []()
+                            { return string("\t could not listen\n"); });
+            return;
+        }
+        std::thread serving([&server]()
+                            { server->run([](std::string_view request, std::ostream &response)
+                                          {
+                                              if (request == "big")
+                                              {
+                                                  response << string(1 << 20, 'x');
+                                              }
+                                              else
+                                              {
+                                                  response << "got " << request;
+                                              } },
+                                          1, 1 << 16); });
+        // far more than the socket buffers hold
+        int stalled = connect_to(path);
+        string requests;
+        for (size_t i = 0; i < 64; i += 1)
+        {
+            requests += "big\n";
+        }
+        bool sent = stalled >= 0 && write(stalled, requests.data(), requests.size()) == static_cast<ssize_t>(requests.size());
+        string received = exchange(path, "a\n", 1);
+        close(stalled);
+        server->stop();
+        serving.join();
+        print_test_case(sent && received == "got a\n\n", "Clients that don't read don't hold the workers", [&received]()
+                        { return "\t got: " + received.substr(0, 100) + "\n"; });
+    }
+
+    // A socket left over by a killed server is replaced, but never a regular file
+    static void run_stale_socket()
+    {
+        string path = (std::filesystem::temp_directory_path() / "nitro_server_stale.sock").string();
+        {
+            // bound then closed without unlinking, like a killed server leaves it
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            std::copy(path.begin(), path.end(), address.sun_path);
+            bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+            close(fd);
+        }
+        bool passed = std::filesystem::is_socket(path) && Server::listen(path).has_value();
+        std::ofstream(path) << "not a socket";
+        passed = passed && !Server::listen(path).has_value();
+        std::filesystem::remove(path);
+        print_test_case(passed, "Stale sockets are replaced, files are not", []()
+                        { return string("\t unexpected listen result\n"); });
+    }
+};
+
 int main()
 {
     RectangleTest::runAll();
     IntersectionTest::runAll();
+    InputTest::runAll();
+    IdSetTest::runAll();
+    IntersectKernelTest::runAll();
+    EngineTest::runAll();
+    OutputTest::runAll();
+    CoverageTest::runAll();
+    SpatialIndexTest::runAll();
+    IntersectionIndexTest::runAll();
+    StatsTest::runAll();
+    ServerTest::runAll();
 }